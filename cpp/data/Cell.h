@@ -2,33 +2,174 @@
 #define CELL_H
 
 #include "../io/Params.h"
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <vector>
 using namespace std;
 
 
+// A cell does not know its own row and column: cells are addressed by their row-major
+// index in the window (row * ncols + col), which Matrix limits to 30 bits.
 class Cell {
     public:
+        // origin of cells never reached by the propagation
+        static const uint32_t NO_ORIGIN = 0xFFFFFFFF;
+        // largest weight: a cell is counted once by each cell whose origin chain passes
+        // through it, at most the 2^30 cells of a window but itself
+        static const uint32_t MAX_WEIGHT = (1u << 30) - 1;
+
         float elevation;
-        float altitude; // = nodataltitude, set after reading the file and getting nodataltitude;
-        size_t oi =0;    
-        size_t oj =0;    
-        size_t i;
-        size_t j;
-        size_t weight =0;
-        bool ground = false;
-        bool mountain_pass = false;
+        union {
+            float altitude; // = nodataltitude, set after reading the file and getting nodataltitude;
+            // --fixed-point: the altitude in whole decimetres, only while the propagation runs
+            // (Matrix::propagate converts to and from altitude around it)
+            int32_t altitude_dm;
+        };
+        uint32_t origin = NO_ORIGIN;    // index of the cell the glide is computed from, itself for ground and home
+        uint32_t weight : 30;
+        uint32_t ground : 1;
+        uint32_t mountain_pass : 1;
+
+        Cell(int elev = 0);
+
+        // home, at index self
+        void initialize(const Params& params, uint32_t self);
 
-        Cell(int elev = 0, size_t row = 0, size_t col = 0);
+        static bool isInView(const size_t x1, const size_t y1, const size_t x2, const size_t y2, const vector<vector<Cell>>& mat);
 
-        void initialize(const Params& params);
+        inline float altitudeRequiseDepuis(const int decalage_i, const int decalage_j, float cellsize_over_finesse) const {
+            return distance(decalage_i, decalage_j) * cellsize_over_finesse + this->altitude;
+        }
 
-        bool isInView(const size_t x2,const size_t y2, vector<vector<Cell>>& mat) const;
+        // --fixed-point: the same in integer decimetres, the glide loss rounded to the decimetre
+        inline int32_t altitudeRequiseDepuisFixe(const int decalage_i, const int decalage_j, float cellsize_over_finesse) const {
+            return this->altitude_dm + static_cast<int32_t>(lrint(distance(decalage_i, decalage_j) * cellsize_over_finesse * 10.0));
+        }
 
-        float altitudeRequiseDepuis(const vector<vector<Cell>>& matrix, const int decalage_i, const int decalage_j,float cellsize_over_finesse) const;    
+        // Distance in cells of an offset. The squared distance is exact in integers and IEEE
+        // sqrt is correctly rounded, so unlike hypot (off by one ulp for about 0.6% of offsets
+        // with glibc 2.36) the result is the same on every platform; it is also 4x faster.
+        static inline double distance(const int64_t di, const int64_t dj) {
+            return sqrt(static_cast<double>(di * di + dj * dj));
+        }
 
-        bool calculate(const vector<vector<Cell>>& mat,const size_t oi, const size_t oj,const Params& params);    
+        // candidate origin (oi, oj) for this cell at (i, j) of a window ncols wide; inline for
+        // the propagation kernels of Matrix.cpp
+        inline bool calculate(const vector<vector<Cell>>& mat, const size_t i, const size_t j, const size_t oi, const size_t oj,
+                              const size_t ncols, const float cellsize_over_finesse, const float nodataltitude) {
+            const int di = static_cast<int>(i) - static_cast<int>(oi), dj = static_cast<int>(j) - static_cast<int>(oj);
+            float requiredAltitude = mat[oi][oj].altitudeRequiseDepuis(di, dj, cellsize_over_finesse);
+            if (this->origin != NO_ORIGIN && requiredAltitude >= this->altitude) {
+                return false;
+            }
+            if (requiredAltitude <= this->elevation) {
+                this->altitude = this->elevation;
+                this->origin = static_cast<uint32_t>(i * ncols + j);
+                this->ground = true;
+            } else {
+                this->altitude = requiredAltitude;
+                this->origin = static_cast<uint32_t>(oi * ncols + oj);
+            }
+            return requiredAltitude < nodataltitude;
+        }
+
+        // calculate on altitude_dm (--fixed-point): candidates are compared in integer
+        // decimetres; the ground and nodataltitude tests are on the candidate in metres, and
+        // a ground cell keeps its elevation rounded to the decimetre until converted back
+        inline bool calculateFixe(const vector<vector<Cell>>& mat, const size_t i, const size_t j, const size_t oi, const size_t oj,
+                                  const size_t ncols, const float cellsize_over_finesse, const float nodataltitude) {
+            const int di = static_cast<int>(i) - static_cast<int>(oi), dj = static_cast<int>(j) - static_cast<int>(oj);
+            const int32_t required = mat[oi][oj].altitudeRequiseDepuisFixe(di, dj, cellsize_over_finesse);
+            if (this->origin != NO_ORIGIN && required >= this->altitude_dm) {
+                return false;
+            }
+            const float requiredAltitude = static_cast<float>(required / 10.0);
+            if (requiredAltitude <= this->elevation) {
+                this->altitude_dm = static_cast<int32_t>(lrint(this->elevation * 10.0));
+                this->origin = static_cast<uint32_t>(i * ncols + j);
+                this->ground = true;
+            } else {
+                this->altitude_dm = required;
+                this->origin = static_cast<uint32_t>(oi * ncols + oj);
+            }
+            return requiredAltitude < nodataltitude;
+        }
 
 };
 
+// The Bresenham walk of isInView from (x1, y1) to (x2, y2), which are clear of each other
+// unless blocked(x, y) holds for a cell of the line or a corner it cuts (the start
+// excluded). Neighbouring cells always see each other.
+template <class Blocked>
+bool lineIsClear(size_t x1, size_t y1, const size_t x2, const size_t y2, Blocked blocked) {
+    if (x1 == x2 && y1 == y2) {
+        return true;
+    }
+    if (abs(static_cast<int>(x1) - static_cast<int>(x2)) <= 1 && abs(static_cast<int>(y1) - static_cast<int>(y2)) <= 1) {
+        return true;
+    }
+
+    int xstep = (x2 > x1) ? 1 : -1;
+    int ystep = (y2 > y1) ? 1 : -1;
+
+    int dx = abs(static_cast<int>(x2) - static_cast<int>(x1));
+    int dy = abs(static_cast<int>(y2) - static_cast<int>(y1));
+
+    int ddy = dy * 2;
+    int ddx = dx * 2;
+
+    int error = dx;
+    int errorprev = error;
+
+    if (dx >= dy) {
+        for (size_t i = 0; i < static_cast<size_t>(dx); ++i) {
+            x1 += xstep;
+            error += ddy;
+            if (error > ddx) {
+                y1 += ystep;
+                error -= ddx;
+                if (error + errorprev < ddx) {
+                    if (blocked(x1, y1 - ystep)) {
+                        return false;
+                    }
+                } else if (error + errorprev > ddx) {
+                    if (blocked(x1 - xstep, y1)) {
+                        return false;
+                    }
+                }
+            }
+            if (blocked(x1, y1)) {
+                return false;
+            }
+            errorprev = error;
+        }
+    } else {
+        for (size_t i = 0; i < static_cast<size_t>(dy); ++i) {
+            y1 += ystep;
+            error += ddx;
+            if (error > ddy) {
+                x1 += xstep;
+                error -= ddy;
+                if (error + errorprev < ddy) {
+                    if (blocked(x1 - xstep, y1)) {
+                        return false;
+                    }
+                } else if (error + errorprev > ddy) {
+                    if (blocked(x1, y1 - ystep)) {
+                        return false;
+                    }
+                }
+            }
+            if (blocked(x1, y1)) {
+                return false;
+            }
+            errorprev = error;
+        }
+    }
+
+    return true;
+}
+
 #endif // CELL_H
\ No newline at end of file
@@ -1,24 +1,130 @@
 #include "Matrix.h"
 
+#include "../geo/Contours.h"
+#include "../geo/TransverseMercator.h"
+#include "../io/AscGrid.h"
+#include "../io/ContourWriter.h"
 #include "../io/Params.h"
 #include "Cell.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <queue>
 #include <sstream>
 #include <stdexcept>
-#include <tuple>
+#include <thread>
 #include <vector>
 using namespace std;
 
+const int Matrix::PROPAGATION_VERSION;
 
 // Constructor
 Matrix::Matrix(Params& params) {
     readFile(params);
 }
 
+// Topography already in memory (batch mode), same window as readFile
+Matrix::Matrix(Params& params, const AscGrid& topography) {
+    params.global_ncols = topography.ncols;
+    params.global_nrows = topography.nrows;
+    params.xllcorner = topography.xllcorner;
+    params.yllcorner = topography.yllcorner;
+    params.cellsize_m = topography.cellsize;
+    size_t homei, homej;
+    globalHome(params, homei, homej);
+    setWindow(params, topography.at(homei, homej));
+
+    for (size_t i = 0; i < this->nrows; ++i) {
+        for (size_t j = 0; j < this->ncols; ++j) {
+            Cell* cell = &this->mat[i][j];
+            cell->elevation = topography.at(start_i + i, start_j + j);
+            cell->altitude = params.nodataltitude;
+        }
+    }
+}
+
+// Coarse level solved for the --preview frames; home keeps its altitude, the rest is unreached
+Matrix::Matrix(const Matrix& fine, size_t factor, const Params& params) {
+    this->nrows = (fine.nrows + factor - 1) / factor;
+    this->ncols = (fine.ncols + factor - 1) / factor;
+    this->start_i = this->start_j = 0;
+    this->end_i = this->nrows - 1;
+    this->end_j = this->ncols - 1;
+    this->homei = fine.homei / factor;
+    this->homej = fine.homej / factor;
+    this->mat.assign(this->nrows, vector<Cell>(this->ncols));
+
+    for (size_t bi = 0; bi < this->nrows; ++bi) {
+        for (size_t bj = 0; bj < this->ncols; ++bj) {
+            Cell* cell = &this->mat[bi][bj];
+            cell->elevation = -numeric_limits<float>::max();
+            for (size_t i = bi * factor; i < min(fine.nrows, (bi + 1) * factor); ++i) {
+                for (size_t j = bj * factor; j < min(fine.ncols, (bj + 1) * factor); ++j) {
+                    cell->elevation = max(cell->elevation, fine.mat[i][j].elevation);
+                }
+            }
+            cell->altitude = params.nodataltitude;
+        }
+    }
+    Cell& home = this->mat[this->homei][this->homej];
+    home.altitude = fine.mat[fine.homei][fine.homej].altitude;
+    home.origin = index(this->homei, this->homej);
+}
+
+// Part of the topography within reach of home. Every altitude the propagation sets is
+// at least home altitude + straight distance * cellsize_over_finesse, so no cell beyond
+// the disc where that reaches nodataltitude is ever updated, and its immediate fringe
+// is the farthest any cell is even looked at.
+void Matrix::setWindow(Params& params, float homeElevation) {
+    params.cellsize_over_finesse = params.cellsize_m / params.finesse;
+
+    // Define subsection parameters
+    size_t radius = static_cast<size_t>(params.nodataltitude / params.cellsize_over_finesse);
+    float budget = params.nodataltitude - (homeElevation + params.securite);
+    size_t reachable = budget > 0 ? static_cast<size_t>(ceil(budget / params.cellsize_over_finesse)) + 1 : 1;
+    radius = min(radius, reachable);
+
+    size_t global_homei, global_homej;
+    globalHome(params, global_homei, global_homej);
+
+    this->start_i = max(static_cast<int>(global_homei) - static_cast<int>(radius), 0);
+    this->end_i = min(global_homei + radius, params.global_nrows - 1);
+    this->start_j = max(static_cast<int>(global_homej) - static_cast<int>(radius), 0);
+    this->end_j = min(global_homej + radius, params.global_ncols - 1);
+
+    this->nrows = end_i - start_i + 1;
+    this->ncols = end_j - start_j + 1;
+    if (this->nrows * this->ncols > (size_t(1) << 30)) {
+        throw runtime_error("The window around home exceeds 2^30 cells.");
+    }
+
+    this->homei = global_homei - start_i;
+    this->homej = global_homej - start_j;
+
+    this->mat.resize(this->nrows, vector<Cell>(this->ncols));
+}
+
+// Row and column of home in the whole topography
+void Matrix::globalHome(const Params& params, size_t& i, size_t& j) {
+    double row = params.global_nrows - 1 - static_cast<long>((params.homey - params.yllcorner) / params.cellsize_m);
+    double col = static_cast<long>((params.homex - params.xllcorner) / params.cellsize_m);
+    if (row < 0 || col < 0 || row >= params.global_nrows || col >= params.global_ncols) {
+        throw runtime_error("Home is outside the topography.");
+    }
+    i = static_cast<size_t>(row);
+    j = static_cast<size_t>(col);
+}
+
 // Method to read from file
 void Matrix::readFile(Params& params) {
     ifstream file(params.topology);
@@ -45,26 +151,23 @@ void Matrix::readFile(Params& params) {
         if (!getline(file, line5)) throw runtime_error("Failed to read cellsize from file.");
         params.cellsize_m = stod(line5.substr(line5.find(' ') + 1));
 
-        params.cellsize_over_finesse = params.cellsize_m / params.finesse;
-
-        // Define subsection parameters
-        size_t radius = static_cast<size_t>(params.nodataltitude / params.cellsize_over_finesse);
-
-        size_t global_homei = params.global_nrows - 1 - static_cast<size_t>((params.homey - params.yllcorner) / params.cellsize_m);
-        size_t global_homej = static_cast<size_t>((params.homex - params.xllcorner) / params.cellsize_m);
-
-        this->start_i = max(static_cast<int>(global_homei) - static_cast<int>(radius), 0);
-        this->end_i = min(global_homei + radius, params.global_nrows - 1);
-        this->start_j = max(static_cast<int>(global_homej) - static_cast<int>(radius), 0);
-        this->end_j = min(global_homej + radius, params.global_ncols - 1);
-
-        this->nrows = end_i - start_i + 1;
-        this->ncols = end_j - start_j + 1;
-
-        this->homei = global_homei - start_i;
-        this->homej = global_homej - start_j;
+        // home elevation first, it sizes the window
+        streampos dataStart = file.tellg();
+        size_t global_homei, global_homej;
+        globalHome(params, global_homei, global_homej);
+        for (size_t i = 0; i < global_homei; ++i) {
+            file.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+        if (!getline(file, line1)) throw runtime_error("Failed to read the elevation of home.");
+        istringstream homeLine(line1);
+        for (size_t j = 0; j < global_homej; ++j) {
+            homeLine.ignore(numeric_limits<streamsize>::max(), ' ');
+        }
+        float homeElevation;
+        if (!(homeLine >> homeElevation)) throw runtime_error("Failed to read the elevation of home.");
+        file.seekg(dataStart);
 
-        this->mat.resize(this->nrows, vector<Cell>(this->ncols));
+        setWindow(params, homeElevation);
 
         // Skip to the relevant rows
         for (int i = 0; i < start_i; ++i) {
@@ -89,8 +192,6 @@ void Matrix::readFile(Params& params) {
                 if (!(iss_line >> cell->elevation)) {
                     throw runtime_error("Failed to read elevation data for cell at position " + to_string(i) + ", " + to_string(j));
                 }
-                cell->i = i;
-                cell->j = j;
                 cell->altitude = params.nodataltitude;
             }
         }
@@ -100,53 +201,278 @@ void Matrix::readFile(Params& params) {
     }
 }
 
-void Matrix::calculate_safety_altitude(const Params& params) {
-    deque<tuple<size_t, size_t, size_t, size_t>> stack;
-        
-    vector<tuple<size_t, size_t, size_t, size_t>> initial_stack = neighbours_with_different_origin_for_stack(this->homei, this->homej);
-    stack.insert(stack.end(), initial_stack.begin(), initial_stack.end());
+size_t Matrix::calculate_safety_altitude(const Params& params) {
+    deque<pair<uint32_t, uint32_t>> stack;
+    push_home_neighbours(params, stack, this->homei, this->homej);
+    return propagate(params, stack);
+}
 
-    while (!stack.empty()) {
+void Matrix::push_home_neighbours(const Params& params, deque<pair<uint32_t, uint32_t>>& stack,
+                                  const size_t i, const size_t j) const {
+    if (params.neighbours == 8) push_neighbours<true>(stack, i, j);
+    else push_neighbours<false>(stack, i, j);
+}
+
+size_t Matrix::propagate(const Params& params, deque<pair<uint32_t, uint32_t>>& stack, size_t max_pops) {
+    const bool diagonals = params.neighbours == 8;
+    if (params.fixed_point) {
+        size_t pops;
+        to_decimetres();
+        pops = diagonals ? propagate_kernel<true, true>(params, stack, max_pops)
+                         : propagate_kernel<true, false>(params, stack, max_pops);
+        to_metres(params);
+        return pops;
+    }
+    return diagonals ? propagate_kernel<false, true>(params, stack, max_pops)
+                     : propagate_kernel<false, false>(params, stack, max_pops);
+}
+
+void Matrix::to_decimetres() {
+    for (vector<Cell>& row : this->mat) {
+        for (Cell& cell : row) {
+            cell.altitude_dm = static_cast<int32_t>(lrint(cell.altitude * 10.0));
+        }
+    }
+}
+
+void Matrix::to_metres(const Params& params) {
+    for (vector<Cell>& row : this->mat) {
+        for (Cell& cell : row) {
+            if (cell.ground) cell.altitude = cell.elevation;
+            else if (cell.origin == Cell::NO_ORIGIN) cell.altitude = params.nodataltitude;
+            else cell.altitude = static_cast<float>(cell.altitude_dm / 10.0);
+        }
+    }
+}
+
+template <bool FixedPoint, bool Diagonals>
+size_t Matrix::propagate_kernel(const Params& params, deque<pair<uint32_t, uint32_t>>& stack, size_t max_pops) {
+    const size_t ncols = this->ncols;
+    // copies: the compiler cannot tell that stores to cells leave params alone
+    const float cellsize_over_finesse = params.cellsize_over_finesse, nodataltitude = params.nodataltitude;
+    const vector<vector<Cell>>& mat = this->mat;
+    auto blocked = [&](size_t x, size_t y) { return mat[x][y].ground != 0; };
+    size_t pops = 0;
+    while (!stack.empty() && pops < max_pops) {
         
-        size_t i, j, parenti, parentj;
-        tie(i, j, parenti, parentj) = stack.front();
+        uint32_t k = stack.front().first, p = stack.front().second;
         stack.pop_front();
+        ++pops;
         
+        size_t i = k / ncols, j = k % ncols;
         Cell& cell = this->mat[i][j];
-        Cell& parent = this->mat[parenti][parentj];
+        const Cell& parent = this->mat[p / ncols][p % ncols];
 
-        if(parent.oi==cell.oi && parent.oj==cell.oj){continue;}
+        if(parent.origin==cell.origin){continue;}
         if(cell.ground){continue;}
 
 
-        size_t oi_elected,oj_elected;
-        if( cell.isInView(parent.oi,parent.oj,this->mat)){
-            oi_elected=parent.oi;
-            oj_elected=parent.oj;
+        uint32_t elected;
+        if (lineIsClear(i, j, parent.origin / ncols, parent.origin % ncols, blocked)) {
+            elected=parent.origin;
         } else {
-            oi_elected=parent.i;
-            oj_elected=parent.j;
+            elected=p;
         }
 
-        if(oi_elected==cell.oi && oj_elected==cell.oj){continue;} 
-        bool updated;
-        updated = cell.calculate(this->mat, oi_elected, oj_elected, params);
+        if(elected==cell.origin){continue;} 
+        bool updated = FixedPoint ? cell.calculateFixe(this->mat, i, j, elected / ncols, elected % ncols, ncols,
+                                                       cellsize_over_finesse, nodataltitude)
+                                  : cell.calculate(this->mat, i, j, elected / ncols, elected % ncols, ncols,
+                                                   cellsize_over_finesse, nodataltitude);
 
         // add nb cells with different origins to stack
         if (updated){
-            auto new_neighbours = neighbours_with_different_origin_for_stack(i, j);
-            stack.insert(stack.end(), new_neighbours.begin(), new_neighbours.end());
-            // if (parent.ground && !cell.ground){
-            //     cell.mountain_pass = true;
-            // } else {
-            //     cell.mountain_pass = false;
-            // }
+            push_neighbours<Diagonals>(stack, i, j);
         }
     }
+    return pops;
 }
 
-bool Matrix::isInsideMatrix(const size_t i, const size_t j) const {
-return i >= 0 && i < this->nrows && j >= 0 && j < this->ncols;
+namespace {
+    const char CHECKPOINT_MAGIC[4] = {'M', 'C', 'C', '1'};
+    const size_t CHECKPOINT_SLICE = 1 << 20;    // queue pops between two looks at the clock
+
+    // what a checkpoint holds, copied out of the matrix so that it can be written while
+    // the propagation goes on. Elevations are only hashed (FNV-1a), they do not change.
+    // "MCC1" | header count (uint32) | header (doubles) | elevation hash, pops (uint64)
+    //   | altitudes (float) | origins (uint32) | ground (uint8)
+    //   | queue length (uint64) | (cell, parent) pairs (uint32)
+    class Checkpoint {
+        public:
+            vector<double> header;
+            uint64_t elevations = 0, pops = 0;
+            vector<float> altitude;
+            vector<uint32_t> origin;
+            vector<uint8_t> ground;
+            vector<pair<uint32_t, uint32_t>> queue;
+    };
+
+    // window and parameters a checkpoint is valid for
+    vector<double> checkpointHeader(const Matrix& M, const Params& params) {
+        return {static_cast<double>(M.nrows), static_cast<double>(M.ncols),
+                static_cast<double>(M.start_i), static_cast<double>(M.start_j),
+                static_cast<double>(M.homei), static_cast<double>(M.homej),
+                static_cast<double>(params.global_nrows), static_cast<double>(params.global_ncols),
+                params.xllcorner, params.yllcorner, params.cellsize_m,
+                params.finesse, params.distSol, params.securite, params.nodataltitude,
+                params.fixed_point ? 1.0 : 0.0, static_cast<double>(params.neighbours)};
+    }
+
+    template <class T>
+    void writeArray(ofstream& out, const vector<T>& v) {
+        out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+
+    template <class T>
+    void readArray(ifstream& in, vector<T>& v, size_t n) {
+        v.resize(n);
+        in.read(reinterpret_cast<char*>(v.data()), n * sizeof(T));
+    }
+
+    uint64_t elevationHash(const Matrix& M) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const vector<Cell>& row : M.mat) {
+            for (const Cell& cell : row) {
+                uint32_t bits;
+                memcpy(&bits, &cell.elevation, sizeof(bits));
+                for (int b = 0; b < 4; ++b) hash = (hash ^ ((bits >> (8 * b)) & 0xFF)) * 1099511628211ULL;
+            }
+        }
+        return hash;
+    }
+
+    Checkpoint takeCheckpoint(const Matrix& M, const Params& params, uint64_t elevations, size_t pops,
+                              const deque<pair<uint32_t, uint32_t>>& stack) {
+        const size_t n = M.nrows * M.ncols;
+        Checkpoint checkpoint;
+        checkpoint.header = checkpointHeader(M, params);
+        checkpoint.elevations = elevations;
+        checkpoint.pops = pops;
+        checkpoint.altitude.resize(n);
+        checkpoint.origin.resize(n);
+        checkpoint.ground.resize(n);
+        for (size_t i = 0; i < M.nrows; ++i) {
+            for (size_t j = 0; j < M.ncols; ++j) {
+                const Cell& cell = M.mat[i][j];
+                checkpoint.altitude[i * M.ncols + j] = cell.altitude;
+                checkpoint.origin[i * M.ncols + j] = cell.origin;
+                checkpoint.ground[i * M.ncols + j] = cell.ground;
+            }
+        }
+        checkpoint.queue.assign(stack.begin(), stack.end());
+        return checkpoint;
+    }
+
+    void writeCheckpoint(const Checkpoint& checkpoint, const string& path) {
+        string temporary = path + ".tmp";
+        {
+            ofstream out(temporary, ios::binary);
+            uint32_t count = static_cast<uint32_t>(checkpoint.header.size());
+            uint64_t length = checkpoint.queue.size();
+            out.write(CHECKPOINT_MAGIC, 4);
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            writeArray(out, checkpoint.header);
+            out.write(reinterpret_cast<const char*>(&checkpoint.elevations), sizeof(uint64_t));
+            out.write(reinterpret_cast<const char*>(&checkpoint.pops), sizeof(uint64_t));
+            writeArray(out, checkpoint.altitude);
+            writeArray(out, checkpoint.origin);
+            writeArray(out, checkpoint.ground);
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            writeArray(out, checkpoint.queue);
+            if (!out) throw runtime_error("Unable to write " + temporary);
+        }
+        // the previous checkpoint stays whole until the new one is
+        if (rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(path.c_str());       // Windows does not replace existing files
+            if (rename(temporary.c_str(), path.c_str()) != 0) {
+                remove(temporary.c_str());
+                throw runtime_error("Unable to write " + path);
+            }
+        }
+    }
+
+    // the checkpoint at path into M and stack when it was taken on the same window,
+    // parameters and elevations; M is untouched otherwise
+    bool readCheckpoint(Matrix& M, const Params& params, const string& path,
+                        deque<pair<uint32_t, uint32_t>>& stack, size_t& pops) {
+        const size_t n = M.nrows * M.ncols;
+        ifstream in(path, ios::binary);
+        if (!in) return false;
+        char magic[4];
+        uint32_t count = 0;
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!in || memcmp(magic, CHECKPOINT_MAGIC, 4) != 0) return false;
+        Checkpoint checkpoint;
+        readArray(in, checkpoint.header, count);
+        in.read(reinterpret_cast<char*>(&checkpoint.elevations), sizeof(uint64_t));
+        in.read(reinterpret_cast<char*>(&checkpoint.pops), sizeof(uint64_t));
+        if (!in || checkpoint.header != checkpointHeader(M, params) || checkpoint.elevations != elevationHash(M)) {
+            return false;
+        }
+        readArray(in, checkpoint.altitude, n);
+        readArray(in, checkpoint.origin, n);
+        readArray(in, checkpoint.ground, n);
+        uint64_t length = 0;
+        in.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if (!in) return false;
+        readArray(in, checkpoint.queue, length);
+        if (!in) return false;
+
+        for (size_t i = 0; i < M.nrows; ++i) {
+            for (size_t j = 0; j < M.ncols; ++j) {
+                Cell& cell = M.mat[i][j];
+                cell.altitude = checkpoint.altitude[i * M.ncols + j];
+                cell.origin = checkpoint.origin[i * M.ncols + j];
+                cell.ground = checkpoint.ground[i * M.ncols + j] != 0;
+            }
+        }
+        stack.assign(checkpoint.queue.begin(), checkpoint.queue.end());
+        pops = checkpoint.pops;
+        return true;
+    }
+}
+
+size_t Matrix::calculate_safety_altitude_checkpointed(const Params& params) {
+    const string& path = params.checkpoint_file;
+    const uint64_t elevations = elevationHash(*this);
+    deque<pair<uint32_t, uint32_t>> stack;
+    size_t pops = 0;
+    if (params.resume && readCheckpoint(*this, params, path, stack, pops)) {
+        cout << "Resuming from " << path << " after " << pops << " queue pops." << endl;
+    } else {
+        if (params.resume) cout << "No matching checkpoint in " << path << ", starting from home." << endl;
+        push_home_neighbours(params, stack, this->homei, this->homej);
+    }
+
+    // the loop runs in slices; between two, a checkpoint that falls due is copied and
+    // handed to the writer, unless the previous one is still being written
+    atomic<bool> writing(false);
+    string failure;
+    thread writer;
+    auto last = chrono::steady_clock::now();
+    while (!stack.empty()) {
+        pops += propagate(params, stack, CHECKPOINT_SLICE);
+        if (stack.empty() || writing) continue;
+        auto now = chrono::steady_clock::now();
+        if (chrono::duration<double>(now - last).count() < params.checkpoint_every) continue;
+        if (writer.joinable()) writer.join();
+        shared_ptr<Checkpoint> checkpoint = make_shared<Checkpoint>(takeCheckpoint(*this, params, elevations, pops, stack));
+        writing = true;
+        writer = thread([checkpoint, &path, &writing, &failure]() {
+            try {
+                writeCheckpoint(*checkpoint, path);
+            } catch (const exception& e) {
+                failure = e.what();
+            }
+            writing = false;
+        });
+        last = now;
+    }
+    if (writer.joinable()) writer.join();
+    if (!failure.empty()) cerr << "Checkpoint not written: " << failure << endl;
+    remove(path.c_str());
+    return pops;
 }
 
 void Matrix::update_altitude_for_ground_cells(const float altivisu) {
@@ -209,11 +535,58 @@ void Matrix::write_output(const Params& params, const string& destinationFile, c
     }
 }
 
+AscGrid Matrix::output_grid(const Params& params) const {
+    AscGrid grid;
+    grid.ncols = this->ncols;
+    grid.nrows = this->nrows;
+    grid.xllcorner = params.xllcorner + this->start_j * params.cellsize_m;
+    grid.yllcorner = params.yllcorner + (params.global_nrows - 1 - this->end_i) * params.cellsize_m;
+    grid.cellsize = params.cellsize_m;
+    grid.nodata = params.nodataltitude;
+    grid.has_nodata = true;
+    grid.data.resize(this->nrows * this->ncols);
+    for (size_t i = 0; i < this->nrows; ++i) {
+        for (size_t j = 0; j < this->ncols; ++j) {
+            grid.data[i * this->ncols + j] = this->mat[i][j].altitude;
+        }
+    }
+    return grid;
+}
+
+AscGrid Matrix::coarse_output_grid(const Params& params, size_t factor) const {
+    Matrix coarse(*this, factor, params);
+    Params coarseParams = params;
+    coarseParams.cellsize_over_finesse = params.cellsize_over_finesse * factor;
+    coarse.calculate_safety_altitude(coarseParams);
+    coarse.update_altitude_for_ground_cells(0);
+
+    AscGrid grid;
+    grid.ncols = coarse.ncols;
+    grid.nrows = coarse.nrows;
+    grid.cellsize = params.cellsize_m * factor;
+    grid.xllcorner = params.xllcorner + this->start_j * params.cellsize_m;
+    // the last row and column of blocks may reach past the window
+    grid.yllcorner = params.yllcorner + (params.global_nrows - this->start_i) * params.cellsize_m - grid.nrows * grid.cellsize;
+    grid.nodata = params.nodataltitude;
+    grid.has_nodata = true;
+    grid.data.resize(coarse.nrows * coarse.ncols);
+    for (size_t i = 0; i < coarse.nrows; ++i) {
+        for (size_t j = 0; j < coarse.ncols; ++j) {
+            grid.data[i * coarse.ncols + j] = coarse.mat[i][j].altitude;
+        }
+    }
+    return grid;
+}
+
 void Matrix::detect_passes(Params& params) {
     for (size_t i = 0; i < this->nrows; ++i) {
         for (size_t j = 0; j < this->ncols; ++j) {
             Cell& cell = this->mat[i][j];
-            Cell& origin = this->mat[cell.oi][cell.oj];
+            if (cell.origin == Cell::NO_ORIGIN) {
+                cell.mountain_pass = false;
+                continue;
+            }
+            Cell& origin = this->mat[cell.origin / this->ncols][cell.origin % this->ncols];
             if (origin.ground && !cell.ground){
                 cell.mountain_pass = true;
             } else {
@@ -228,51 +601,115 @@ void Matrix::detect_passes(Params& params) {
 void Matrix::weight_passes(Params& params) {
     for (size_t i = 0; i < this->nrows; ++i) {
         for (size_t j = 0; j < this->ncols; ++j) {
-            Cell& cell = this->mat[i][j];
-            update_cell_weight(cell,params);
+            if (this->mat[i][j].origin == Cell::NO_ORIGIN) continue;
+            update_cell_weight(index(i, j),params);
         }
 
     }
 }
 
 
-void Matrix::update_cell_weight(Cell& cell, Params& params, size_t max_depth) {
+void Matrix::update_cell_weight(uint32_t cell, Params& params, size_t max_depth) {
     if (max_depth == 0) {
         throw std::runtime_error("Maximum recursion depth reached.");
     }
 
-    Cell& origin = this->mat[cell.oi][cell.oj];
+    uint32_t o = this->mat[cell / this->ncols][cell % this->ncols].origin;
+    Cell& origin = this->mat[o / this->ncols][o % this->ncols];
+    // the bit field would wrap to 0 silently
+    if (origin.weight == Cell::MAX_WEIGHT) {
+        throw std::runtime_error("Pass weight exceeds 30 bits.");
+    }
     origin.weight++;
 
     // Check if we should continue recursion
-    if (!origin.ground && (origin.i!=cell.i || origin.j!=cell.j)) { 
-        update_cell_weight(origin, params, max_depth - 1);
+    if (!origin.ground && o != cell) { 
+        update_cell_weight(o, params, max_depth - 1);
     }
 }
 
+vector<MountainPass> Matrix::mountain_passes(const Params& params) const {
+    vector<MountainPass> passes;
+    for (size_t i = 0; i < this->nrows; ++i) {
+        for (size_t j = 0; j < this->ncols; ++j) {
+            const Cell& cell = this->mat[i][j];
+            if (!cell.mountain_pass || cell.weight<=100) continue;
+            const Cell& origine = this->mat[cell.origin / this->ncols][cell.origin % this->ncols];
+            const Cell& oorigine = this->mat[origine.origin / this->ncols][origine.origin % this->ncols];
+            if (oorigine.ground ){
+                MountainPass pass;
+                pass.x = params.xllcorner + (this->start_j+j) * params.cellsize_m;
+                pass.y = params.yllcorner + (params.global_nrows - 1 -this->start_i - i) * params.cellsize_m;
+                pass.weight = cell.weight;
+                passes.push_back(pass);
+            }
+        }
+    }
+    return passes;
+}
+
 void Matrix::write_mountain_passes(const Params& params, const string& destinationFile) const {
     ofstream outputFile(destinationFile);
     
     if (outputFile.is_open()) {
         outputFile <<"name,x,y,weight"<<endl;
         // Write the data
-        for (size_t i = 0; i < this->nrows; ++i) {
-            for (size_t j = 0; j < this->ncols; ++j) {
-                const Cell& cell = this->mat[i][j];
-                const Cell& origine = this->mat[cell.oi][cell.oj];
-                const Cell& oorigine = this->mat[origine.oi][origine.oj];
-                if (cell.mountain_pass && cell.weight>100 && oorigine.ground ){
-                    outputFile <<"pass,"<< params.xllcorner + (this->start_j+cell.j) * params.cellsize_m <<","
-                    << params.yllcorner + (params.global_nrows - 1 -this->start_i - cell.i) * params.cellsize_m <<","
-                    << cell.weight <<endl;
+        for (const MountainPass& pass : mountain_passes(params)) {
+            outputFile <<"pass,"<< pass.x <<"," << pass.y <<"," << pass.weight <<endl;
+        }
 
-                }
+        outputFile.close();
+    } else {
+        cerr << "Unable to open file " << destinationFile << " for writing." << endl;
+    }
+}
+
+void Matrix::write_contours_4326(const Params& params, const string& destinationFile) const {
+    TransverseMercator tm = TransverseMercator::fromFile(params.crs_file);
+
+    // same grid as local.asc: ground (0) and unreached cells are holes
+    vector<float> grid(this->nrows * this->ncols);
+    float data_max = 0;
+    for (size_t i = 0; i < this->nrows; ++i) {
+        for (size_t j = 0; j < this->ncols; ++j) {
+            float altitude = this->mat[i][j].altitude;
+            if (altitude == 0 || altitude == params.nodataltitude) {
+                grid[i * this->ncols + j] = NAN;
+            } else {
+                grid[i * this->ncols + j] = altitude;
+                data_max = max(data_max, altitude);
             }
+        }
+    }
+
+    vector<float> levels;
+    for (float level = 0; level < data_max + params.contour_height; level += params.contour_height) {
+        levels.push_back(level);
+    }
 
+    vector<ContourLine> lines = trace_contours(grid, this->nrows, this->ncols, levels);
+    simplify_contours(lines, params.simplify);
+
+    // grid units -> window metric coordinates (as generate_contours_from_asc) -> lon/lat
+    const double xll = params.xllcorner + this->start_j * params.cellsize_m;
+    const double yll = params.yllcorner + (params.global_nrows - 1 - this->end_i) * params.cellsize_m;
+    const double cellsize = params.cellsize_m;
+    const double top = this->nrows - 1;
+    parallel_for_bands(lines.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t l = begin; l < end; ++l) {
+            ContourLine& line = lines[l];
+            for (size_t k = 0; k < line.x.size(); ++k) {
+                line.x[k] = xll + line.x[k] * cellsize;
+                line.y[k] = yll + (top - line.y[k]) * cellsize;
+            }
+            tm.inverse(line.x.data(), line.y.data(), line.x.data(), line.y.data(), line.x.size());
         }
+    });
 
-        outputFile.close();
+    if (params.contour_format == "topojson") {
+        // a tenth of a cell, in degrees of latitude
+        write_contours_topojson(lines, destinationFile, params.cellsize_m / 10 / 111320.0);
     } else {
-        cerr << "Unable to open file " << destinationFile << " for writing." << endl;
+        write_contours_geojson(lines, destinationFile);
     }
-}
\ No newline at end of file
+}
@@ -1,13 +1,24 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include "../io/AscGrid.h"
 #include "../io/Params.h"
 #include "Cell.h"
 #include <cstddef>
-#include <tuple>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
+// A pass of write_mountain_passes: TM coordinates of the cell and its weight
+class MountainPass {
+    public:
+        float x, y;
+        uint32_t weight;
+};
+
 class Matrix {
 public:
     vector<vector<Cell>> mat;
@@ -16,38 +27,85 @@ public:
     // Constructor
     Matrix(Params& params);
 
+    Matrix(Params& params, const AscGrid& topography);
+
+    // Coarse level of a preview frame: factor x factor blocks of `fine`, each with the
+    // highest elevation of its block
+    Matrix(const Matrix& fine, size_t factor, const Params& params);
+
     // Method to read from file
     void readFile(Params& params);
 
-    void calculate_safety_altitude(const Params& params);
+    // window around home sized from its elevation, see Matrix.cpp
+    void setWindow(Params& params, float homeElevation);
 
-    //peut être pas une bonne idée d'avoir une fonction inline aussi grosse
-    inline vector<tuple<size_t, size_t, size_t, size_t>> neighbours_with_different_origin_for_stack(const size_t i, const size_t j) const {
-        vector<tuple<size_t, size_t, size_t, size_t>> neighbours;
-        const Cell* cellPtr= &this->mat[i][j];
-        const size_t oi = cellPtr->oi;
-        const size_t oj = cellPtr->oj;
+    static void globalHome(const Params& params, size_t& i, size_t& j);
 
-        // Define the 4 directions for neighbors (excluding diagonals)
-        const vector<pair<int, int>> directions = {
-            {-1, 0}, {1, 0}, {0, -1}, {0, 1} // Up, Down, Left, Right
+    // row-major index of (i, j), what Cell::origin and the propagation queue hold
+    inline uint32_t index(const size_t i, const size_t j) const {
+        return static_cast<uint32_t>(i * this->ncols + j);
+    }
+
+    // returns the number of queue pops
+    size_t calculate_safety_altitude(const Params& params);
+
+    // calculate_safety_altitude (--checkpoint) writing the propagation state (altitudes,
+    // origins, ground flags, the queue) to params.checkpoint_file
+    // every params.checkpoint_every seconds. The snapshot is copied between two slices of
+    // the loop and written by a background thread, to a temporary file renamed over the
+    // previous checkpoint; a checkpoint falls due while the last one is still being
+    // written is skipped. With params.resume the propagation starts from the checkpoint
+    // when it matches this window, parameters and elevations, and the result is the same as
+    // without interruption. The file is deleted once the propagation is complete. Returns
+    // the queue pops, those before the checkpoint included.
+    size_t calculate_safety_altitude_checkpointed(const Params& params);
+
+    // (neighbour, cell) pairs pushed straight into the queue for the neighbours whose origin
+    // differs from the cell's: up, down, left, right, then the diagonals for --neighbours 8.
+    // The order is part of the result, the propagation being first in, first out.
+    template <bool Diagonals>
+    inline void push_neighbours(deque<pair<uint32_t, uint32_t>>& stack, const size_t i, const size_t j) const {
+        const uint32_t origin = this->mat[i][j].origin, cell = index(i, j);
+        auto push = [&](size_t ni, size_t nj) {
+            if (this->mat[ni][nj].origin != origin) stack.emplace_back(index(ni, nj), cell);
         };
+        if (i > 0) push(i - 1, j);
+        if (i + 1 < this->nrows) push(i + 1, j);
+        if (j > 0) push(i, j - 1);
+        if (j + 1 < this->ncols) push(i, j + 1);
+        if (Diagonals) {
+            if (i > 0 && j > 0) push(i - 1, j - 1);
+            if (i > 0 && j + 1 < this->ncols) push(i - 1, j + 1);
+            if (i + 1 < this->nrows && j > 0) push(i + 1, j - 1);
+            if (i + 1 < this->nrows && j + 1 < this->ncols) push(i + 1, j + 1);
+        }
+    }
 
-        for (const auto& dir : directions) {
-            size_t ni = i + dir.first;
-            size_t nj = j + dir.second;
+    // the first neighbours of a home, as many as params.neighbours
+    void push_home_neighbours(const Params& params, deque<pair<uint32_t, uint32_t>>& stack, const size_t i, const size_t j) const;
 
-            if (isInsideMatrix(ni,nj)){
-                if (this->mat[ni][nj].oi != oi || this->mat[ni][nj].oj != oj) {
-                    neighbours.emplace_back(ni, nj, i, j);
-                }
-            }
-        }
+    // Version of what the propagation computes, part of the batch --cache keys: bumped by
+    // every change that gives other outputs for the same inputs.
+    // 2: Cell::distance as sqrt of the exact squared offset instead of hypot
+    // 3: --fixed-point propagates whole decimetres instead of rounding float altitudes
+    static const int PROPAGATION_VERSION = 3;
 
-        return neighbours;
-    }
+    // The propagation loop of calculate_safety_altitude from the given (cell, parent)
+    // index pairs. Picks the propagate_kernel instantiation for params and this matrix once.
+    // Stops after max_pops, the rest of the queue left for the next call.
+    // Returns the number of queue pops.
+    size_t propagate(const Params& params, deque<pair<uint32_t, uint32_t>>& stack,
+                     size_t max_pops = SIZE_MAX);
 
-    bool isInsideMatrix(const size_t i, const size_t j) const;
+    // --fixed-point: altitude_dm of every cell from its altitude before the kernel, and
+    // back after it (ground cells to their elevation, cells not reached to nodataltitude)
+    void to_decimetres();
+    void to_metres(const Params& params);
+
+    // propagate for one configuration: --fixed-point and --neighbours 8 are compile-time,
+    // so the loop has no branch on them
+    template <bool FixedPoint, bool Diagonals>
+    size_t propagate_kernel(const Params& params, deque<pair<uint32_t, uint32_t>>& stack, size_t max_pops);
 
     void update_altitude_for_ground_cells(const float altivisu);
 
@@ -55,14 +113,27 @@ public:
 
     void write_output(const Params& params, const string& destinationFile, const bool nozero) const;
 
+    // what write_output(params, path, false) writes, as one row-major grid (Python bindings)
+    AscGrid output_grid(const Params& params) const;
+
+    // --preview: the window solved on blocks of factor cells, ground cells at 0 as in
+    // output_grid, with the same north-west corner.
+    // About factor^2 times fewer queue pops than the full resolution; this matrix, home
+    // initialised and clearance added, is untouched.
+    AscGrid coarse_output_grid(const Params& params, size_t factor) const;
+
     void detect_passes(Params& params);
 
     void weight_passes(Params& params);
 
-    void update_cell_weight(Cell& cell, Params& params, size_t max_depth = 1000);
+    void update_cell_weight(uint32_t cell, Params& params, size_t max_depth = 1000);
+
+    vector<MountainPass> mountain_passes(const Params& params) const;
 
     void write_mountain_passes(const Params& params, const string& destinationFile) const;
 
+    void write_contours_4326(const Params& params, const string& destinationFile) const;
+
 };
 
 #endif // MATRIX_H
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// true on threads started by the helpers below: loops nested inside a parallel
+// one run serially instead of oversubscribing the cores
+inline bool& in_parallel_region() {
+    static thread_local bool inside = false;
+    return inside;
+}
+
+inline size_t worker_count(size_t jobs) {
+    if (in_parallel_region()) return 1;
+    size_t n = thread::hardware_concurrency();
+    if (n == 0) n = 1;
+    return max<size_t>(1, min(n, jobs));
+}
+
+// Splits [0, n) into one contiguous band per worker and calls fn(begin, end, worker)
+// on each band. Bands are contiguous so each thread streams through its own rows.
+template <typename Fn>
+void parallel_for_bands(size_t n, Fn fn) {
+    size_t workers = worker_count(n);
+    if (workers <= 1) {
+        if (n > 0) fn(size_t(0), n, size_t(0));
+        return;
+    }
+    vector<thread> threads;
+    size_t band = (n + workers - 1) / workers;
+    for (size_t w = 0; w < workers; ++w) {
+        size_t begin = w * band;
+        size_t end = min(n, begin + band);
+        if (begin >= end) break;
+        threads.emplace_back([&fn, begin, end, w]() {
+            in_parallel_region() = true;
+            fn(begin, end, w);
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+// Calls fn(k, worker) for every k in [0, n), each worker taking the next k as soon as
+// it is free: for jobs of very different sizes, like one airfield each. At most
+// max_workers threads when it is not 0.
+template <typename Fn>
+void parallel_for_each(size_t n, Fn fn, size_t max_workers = 0) {
+    size_t workers = worker_count(n);
+    if (max_workers > 0) workers = min(workers, max_workers);
+    if (workers <= 1) {
+        for (size_t k = 0; k < n; ++k) fn(k, size_t(0));
+        return;
+    }
+    atomic<size_t> next(0);
+    vector<thread> threads;
+    for (size_t w = 0; w < workers; ++w) {
+        threads.emplace_back([&fn, &next, n, w]() {
+            in_parallel_region() = true;
+            for (size_t k = next++; k < n; k = next++) fn(k, w);
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+#endif // PARALLEL_H
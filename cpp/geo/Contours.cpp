@@ -0,0 +1,264 @@
+#include "Contours.h"
+
+#include "../data/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+    // Edge ids: horizontal edge (r,c)-(r,c+1) is 2*(r*ncols+c), vertical edge (r,c)-(r+1,c) is 2*(r*ncols+c)+1
+    typedef pair<uint64_t, uint64_t> Segment;
+
+    inline uint64_t hEdge(size_t r, size_t c, size_t ncols) { return 2 * (static_cast<uint64_t>(r) * ncols + c); }
+    inline uint64_t vEdge(size_t r, size_t c, size_t ncols) { return 2 * (static_cast<uint64_t>(r) * ncols + c) + 1; }
+
+    inline void edgePoint(const vector<float>& grid, size_t ncols, uint64_t edge, float level, double& x, double& y) {
+        uint64_t cell = edge / 2;
+        size_t r = cell / ncols;
+        size_t c = cell % ncols;
+        float v0 = grid[r * ncols + c];
+        if (edge % 2 == 0) {
+            float v1 = grid[r * ncols + c + 1];
+            x = c + (level - v0) / (v1 - v0);
+            y = r;
+        } else {
+            float v1 = grid[(r + 1) * ncols + c];
+            x = c;
+            y = r + (level - v0) / (v1 - v0);
+        }
+    }
+
+    void squareSegments(const vector<float>& grid, size_t ncols, size_t r, size_t c, float level, vector<Segment>& out) {
+        float ul = grid[r * ncols + c];
+        float ur = grid[r * ncols + c + 1];
+        float ll = grid[(r + 1) * ncols + c];
+        float lr = grid[(r + 1) * ncols + c + 1];
+        if (std::isnan(ul) || std::isnan(ur) || std::isnan(ll) || std::isnan(lr)) return;
+
+        int index = (ul >= level ? 1 : 0) | (ur >= level ? 2 : 0) | (lr >= level ? 4 : 0) | (ll >= level ? 8 : 0);
+        if (index == 0 || index == 15) return;
+
+        uint64_t top = hEdge(r, c, ncols);
+        uint64_t bottom = hEdge(r + 1, c, ncols);
+        uint64_t left = vEdge(r, c, ncols);
+        uint64_t right = vEdge(r, c + 1, ncols);
+        bool centerAbove = (ul + ur + ll + lr) / 4 >= level;
+
+        switch (index) {
+            case 1: case 14: out.emplace_back(top, left); break;
+            case 2: case 13: out.emplace_back(top, right); break;
+            case 3: case 12: out.emplace_back(left, right); break;
+            case 4: case 11: out.emplace_back(right, bottom); break;
+            case 6: case 9:  out.emplace_back(top, bottom); break;
+            case 7: case 8:  out.emplace_back(left, bottom); break;
+            case 5:
+                if (centerAbove) { out.emplace_back(top, right); out.emplace_back(left, bottom); }
+                else             { out.emplace_back(top, left);  out.emplace_back(right, bottom); }
+                break;
+            case 10:
+                if (centerAbove) { out.emplace_back(top, left);  out.emplace_back(right, bottom); }
+                else             { out.emplace_back(top, right); out.emplace_back(left, bottom); }
+                break;
+        }
+    }
+
+    // Each edge is shared by at most two segments: sort (edge, segment) pairs and pair up equal edges.
+    void chainLevel(const vector<float>& grid, size_t ncols, float level, const vector<Segment>& segs, vector<ContourLine>& lines) {
+        size_t n = segs.size();
+        if (n == 0) return;
+
+        vector<pair<uint64_t, uint32_t>> ends;
+        ends.reserve(2 * n);
+        for (size_t s = 0; s < n; ++s) {
+            ends.emplace_back(segs[s].first, static_cast<uint32_t>(s));
+            ends.emplace_back(segs[s].second, static_cast<uint32_t>(s));
+        }
+        sort(ends.begin(), ends.end());
+
+        const uint32_t NONE = UINT32_MAX;
+        // neighbour of segment s through its first (0) or second (1) endpoint
+        vector<uint32_t> next(2 * n, NONE);
+        for (size_t k = 0; k + 1 < ends.size(); ++k) {
+            if (ends[k].first == ends[k + 1].first) {
+                uint32_t a = ends[k].second, b = ends[k + 1].second;
+                next[2 * a + (segs[a].first == ends[k].first ? 0 : 1)] = b;
+                next[2 * b + (segs[b].first == ends[k].first ? 0 : 1)] = a;
+                ++k;
+            }
+        }
+
+        vector<bool> visited(n, false);
+        vector<uint64_t> forwardEdges, backwardEdges;
+        for (size_t s = 0; s < n; ++s) {
+            if (visited[s]) continue;
+            visited[s] = true;
+
+            forwardEdges.assign(1, segs[s].first);
+            forwardEdges.push_back(segs[s].second);
+            backwardEdges.clear();
+
+            // walk forward from the second endpoint
+            bool closed = false;
+            uint32_t cur = static_cast<uint32_t>(s);
+            uint64_t via = segs[s].second;
+            while (true) {
+                uint32_t t = next[2 * cur + (segs[cur].first == via ? 0 : 1)];
+                if (t == NONE) break;
+                if (visited[t]) { closed = (t == s); break; }
+                visited[t] = true;
+                via = (segs[t].first == via) ? segs[t].second : segs[t].first;
+                forwardEdges.push_back(via);
+                cur = t;
+            }
+            // then backward from the first endpoint, unless the ring already closed
+            if (!closed) {
+                cur = static_cast<uint32_t>(s);
+                via = segs[s].first;
+                while (true) {
+                    uint32_t t = next[2 * cur + (segs[cur].first == via ? 0 : 1)];
+                    if (t == NONE || visited[t]) break;
+                    visited[t] = true;
+                    via = (segs[t].first == via) ? segs[t].second : segs[t].first;
+                    backwardEdges.push_back(via);
+                    cur = t;
+                }
+            }
+
+            ContourLine line;
+            line.level = level;
+            size_t count = backwardEdges.size() + forwardEdges.size();
+            line.x.resize(count);
+            line.y.resize(count);
+            size_t k = 0;
+            for (size_t b = backwardEdges.size(); b-- > 0; ++k) {
+                edgePoint(grid, ncols, backwardEdges[b], level, line.x[k], line.y[k]);
+            }
+            for (size_t f = 0; f < forwardEdges.size(); ++f, ++k) {
+                edgePoint(grid, ncols, forwardEdges[f], level, line.x[k], line.y[k]);
+            }
+            lines.push_back(move(line));
+        }
+    }
+}
+
+
+vector<ContourLine> trace_contours(const vector<float>& grid, size_t nrows, size_t ncols, const vector<float>& levels) {
+    vector<ContourLine> result;
+    if (nrows < 2 || ncols < 2 || levels.empty()) return result;
+
+    // segments[band][level]
+    size_t nbands = worker_count(nrows - 1);
+    vector<vector<vector<Segment>>> segments(nbands, vector<vector<Segment>>(levels.size()));
+    parallel_for_bands(nrows - 1, [&](size_t begin, size_t end, size_t band) {
+        vector<vector<Segment>>& mine = segments[band];
+        for (size_t r = begin; r < end; ++r) {
+            for (size_t c = 0; c + 1 < ncols; ++c) {
+                for (size_t l = 0; l < levels.size(); ++l) {
+                    squareSegments(grid, ncols, r, c, levels[l], mine[l]);
+                }
+            }
+        }
+    });
+
+    vector<vector<ContourLine>> perLevel(levels.size());
+    parallel_for_bands(levels.size(), [&](size_t begin, size_t end, size_t) {
+        vector<Segment> all;
+        for (size_t l = begin; l < end; ++l) {
+            all.clear();
+            for (size_t b = 0; b < nbands; ++b) {
+                all.insert(all.end(), segments[b][l].begin(), segments[b][l].end());
+            }
+            chainLevel(grid, ncols, levels[l], all, perLevel[l]);
+        }
+    });
+
+    for (auto& lines : perLevel) {
+        for (auto& line : lines) result.push_back(move(line));
+    }
+    return result;
+}
+
+namespace {
+    // squared distance from p to segment a-b
+    inline double segmentDistance2(double px, double py, double ax, double ay, double bx, double by) {
+        double dx = bx - ax, dy = by - ay;
+        double len2 = dx * dx + dy * dy;
+        double t = len2 > 0 ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0;
+        t = max(0.0, min(1.0, t));
+        double ex = ax + t * dx - px, ey = ay + t * dy - py;
+        return ex * ex + ey * ey;
+    }
+
+    void simplifyLine(vector<double>& x, vector<double>& y, double tolerance, vector<char>& keep, vector<pair<size_t, size_t>>& stack) {
+        size_t n = x.size();
+        if (n < 3) return;
+        bool closed = x[0] == x[n - 1] && y[0] == y[n - 1];
+        double tol2 = tolerance * tolerance;
+
+        keep.assign(n, 0);
+        keep[0] = keep[n - 1] = 1;
+        // a ring's chord is degenerate, so split it at its middle first
+        stack.clear();
+        if (closed && n > 4) {
+            keep[n / 2] = 1;
+            stack.emplace_back(0, n / 2);
+            stack.emplace_back(n / 2, n - 1);
+        } else {
+            stack.emplace_back(0, n - 1);
+        }
+
+        while (!stack.empty()) {
+            size_t first = stack.back().first, last = stack.back().second;
+            stack.pop_back();
+            double worst = -1;
+            size_t index = first;
+            for (size_t k = first + 1; k < last; ++k) {
+                double d2 = segmentDistance2(x[k], y[k], x[first], y[first], x[last], y[last]);
+                if (d2 > worst) { worst = d2; index = k; }
+            }
+            if (worst > tol2) {
+                keep[index] = 1;
+                stack.emplace_back(first, index);
+                stack.emplace_back(index, last);
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t k = 0; k < n; ++k) kept += keep[k];
+        if (closed && kept < 4) return;
+
+        size_t out = 0;
+        for (size_t k = 0; k < n; ++k) {
+            if (keep[k]) {
+                x[out] = x[k];
+                y[out] = y[k];
+                ++out;
+            }
+        }
+        x.resize(out);
+        y.resize(out);
+    }
+}
+
+
+void simplify_contours(vector<ContourLine>& lines, double tolerance) {
+    if (tolerance <= 0) return;
+    parallel_for_bands(lines.size(), [&](size_t begin, size_t end, size_t) {
+        vector<char> keep;
+        vector<pair<size_t, size_t>> stack;
+        for (size_t l = begin; l < end; ++l) {
+            simplifyLine(lines[l].x, lines[l].y, tolerance, keep, stack);
+        }
+    });
+}
+
+void simplify_polyline(vector<double>& x, vector<double>& y, double tolerance) {
+    if (tolerance <= 0) return;
+    vector<char> keep;
+    vector<pair<size_t, size_t>> stack;
+    simplifyLine(x, y, tolerance, keep, stack);
+}
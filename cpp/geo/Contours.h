@@ -0,0 +1,32 @@
+#ifndef CONTOURS_H
+#define CONTOURS_H
+
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// One polyline, coordinates kept as separate x and y rows so that whole lines can be
+// handed to TransverseMercator::inverse in one call.
+class ContourLine {
+    public:
+        float level;
+        vector<double> x;
+        vector<double> y;
+};
+
+// Marching squares over a row-major grid (row 0 = north), same conventions as
+// skimage.measure.find_contours: NaN cells are holes, points are in (row, col)
+// grid units, saddles are resolved with the mean of the four corners.
+// Segment extraction runs in parallel over row bands and line chaining in parallel
+// over levels. The returned points are in grid units: x = col, y = row.
+vector<ContourLine> trace_contours(const vector<float>& grid, size_t nrows, size_t ncols, const vector<float>& levels);
+
+// Douglas-Peucker on every line, in place and in parallel over lines. The tolerance is in
+// the units of the points, so calling it on grid units makes it a fraction of cellsize.
+// Closed rings keep at least 4 points so they stay valid rings.
+void simplify_contours(vector<ContourLine>& lines, double tolerance);
+
+// Douglas-Peucker on a single polyline or ring (first point == last point).
+void simplify_polyline(vector<double>& x, vector<double>& y, double tolerance);
+
+#endif // CONTOURS_H
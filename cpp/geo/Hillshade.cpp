@@ -0,0 +1,302 @@
+#include "Hillshade.h"
+
+#include "../data/Parallel.h"
+#include "../io/PngWriter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HILLSHADE_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    const double EARTH_RADIUS = 6378137.0;
+    const double PI = 3.14159265358979323846;
+    const double DEG = PI / 180;
+    const double MAX_SLOPE = 1.2;       // radians mapped to 255, as in utils/hillshade.py
+    const int TILE_SIZE = 256;
+    const size_t BLOCK_ROWS = 64;
+    const size_t BLOCK_COLS = 1024;     // 3 input rows of a block stay in L1
+
+    double lonToX(double lon) { return lon * DEG * EARTH_RADIUS; }
+    double latToY(double lat) { return EARTH_RADIUS * log(tan(PI / 4 + lat * DEG / 2)); }
+    double xToLon(double x) { return x / EARTH_RADIUS / DEG; }
+    double yToLat(double y) { return atan(sinh(y / EARTH_RADIUS)) / DEG; }
+
+    // utils/simple_mercator.py lat_lon_to_tile
+    void lonLatToTile(double lon, double lat, int zoom, int& tx, int& ty) {
+        double n = ldexp(1.0, zoom);
+        tx = static_cast<int>((lon + 180.0) / 360.0 * n);
+        ty = static_cast<int>((1.0 - asinh(tan(lat * DEG)) / PI) / 2.0 * n);
+    }
+
+    // constants of the per-pixel formula. With g the gradient, the hillshade
+    //   cos(alt) cos(slope) + sin(alt) sin(slope) cos(az - aspect)
+    // is (cos(alt) + sin(alt) z (cos(az) dy - sin(az) dx)) / sqrt(1 + z² g²), no trigonometry
+    class Kernel {
+        public:
+            float cosAlt, a, b, zShades2, zSlopes, slopeScale;
+
+            Kernel(const ShadeParams& p) {
+                cosAlt = static_cast<float>(cos(p.altitude * DEG));
+                a = static_cast<float>(sin(p.altitude * DEG) * p.z_shades * cos(p.azimuth * DEG));
+                b = static_cast<float>(sin(p.altitude * DEG) * p.z_shades * sin(p.azimuth * DEG));
+                zShades2 = static_cast<float>(p.z_shades * p.z_shades);
+                zSlopes = static_cast<float>(p.z_slopes);
+                slopeScale = static_cast<float>(255 / MAX_SLOPE);
+            }
+    };
+
+    // atan on [0, 1], max error 1e-5 rad
+    inline float atanUnit(float t) {
+        float t2 = t * t;
+        return t * (0.99997726f + t2 * (-0.33262347f + t2 * (0.19354346f + t2 * (-0.11643287f +
+                    t2 * (0.05265332f + t2 * -0.01172120f)))));
+    }
+
+    inline uint8_t shadePixel(float dx, float dy, const Kernel& k) {
+        float g2 = dx * dx + dy * dy;
+        float hs = (k.cosAlt + k.a * dy - k.b * dx) / sqrt(1 + k.zShades2 * g2);
+        float hs8 = floor(min(max(hs, 0.0f), 1.0f) * 255);
+
+        float t = k.zSlopes * sqrt(g2);
+        float slope = t > 1 ? static_cast<float>(PI / 2) - atanUnit(1 / t) : atanUnit(t);
+        float slope8 = floor(min(max(slope * k.slopeScale, 0.0f), 255.0f));
+        return static_cast<uint8_t>((hs8 + 255 - slope8) * 0.5f);
+    }
+
+    inline float dxAt(const float* mid, size_t j, size_t ncols, float fx1, float fx2) {
+        if (ncols < 2) return 0;
+        if (j == 0) return (mid[1] - mid[0]) * fx1;
+        if (j == ncols - 1) return (mid[j] - mid[j - 1]) * fx1;
+        return (mid[j + 1] - mid[j - 1]) * fx2;
+    }
+
+#ifdef HILLSHADE_AVX2
+    __attribute__((target("avx2")))
+    inline __m256 atanUnitAvx2(__m256 t) {
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 p = _mm256_set1_ps(-0.01172120f);
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(0.05265332f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(-0.11643287f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(0.19354346f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(-0.33262347f));
+        p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(0.99997726f));
+        return _mm256_mul_ps(p, t);
+    }
+
+    // 8 interior pixels at a time, j in [begin, end) with 1 <= begin, end <= ncols - 1;
+    // returns where it stopped, the scalar loop does the rest
+    __attribute__((target("avx2")))
+    size_t shadeSpanAvx2(const float* up, const float* mid, const float* down, float fy, float fx2,
+                         size_t begin, size_t end, const Kernel& k, uint8_t* out) {
+        const __m256 vfx = _mm256_set1_ps(fx2), vfy = _mm256_set1_ps(fy);
+        const __m256 cosAlt = _mm256_set1_ps(k.cosAlt), va = _mm256_set1_ps(k.a), vb = _mm256_set1_ps(k.b);
+        const __m256 z2 = _mm256_set1_ps(k.zShades2), zl = _mm256_set1_ps(k.zSlopes);
+        const __m256 scale = _mm256_set1_ps(k.slopeScale), one = _mm256_set1_ps(1), zero = _mm256_setzero_ps();
+        const __m256 c255 = _mm256_set1_ps(255), half = _mm256_set1_ps(0.5f), halfPi = _mm256_set1_ps(static_cast<float>(PI / 2));
+        alignas(32) int32_t values[8];
+
+        size_t j = begin;
+        for (; j + 8 <= end; j += 8) {
+            __m256 dx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(mid + j + 1), _mm256_loadu_ps(mid + j - 1)), vfx);
+            __m256 dy = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j)), vfy);
+            __m256 g2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+            __m256 hs = _mm256_sub_ps(_mm256_add_ps(cosAlt, _mm256_mul_ps(va, dy)), _mm256_mul_ps(vb, dx));
+            hs = _mm256_div_ps(hs, _mm256_sqrt_ps(_mm256_add_ps(one, _mm256_mul_ps(z2, g2))));
+            hs = _mm256_floor_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(hs, zero), one), c255));
+
+            __m256 t = _mm256_mul_ps(zl, _mm256_sqrt_ps(g2));
+            __m256 steep = _mm256_cmp_ps(t, one, _CMP_GT_OQ);
+            __m256 u = _mm256_blendv_ps(t, _mm256_div_ps(one, _mm256_max_ps(t, one)), steep);
+            __m256 at = atanUnitAvx2(u);
+            __m256 slope = _mm256_blendv_ps(at, _mm256_sub_ps(halfPi, at), steep);
+            slope = _mm256_floor_ps(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(slope, scale), zero), c255));
+
+            __m256 composite = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(hs, c255), slope), half);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(values), _mm256_cvttps_epi32(composite));
+            for (int l = 0; l < 8; ++l) out[j + l] = static_cast<uint8_t>(values[l]);
+        }
+        return j;
+    }
+
+    bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+    void shadeSpan(const float* up, const float* mid, const float* down, float fy, float fx1, float fx2,
+                   size_t ncols, size_t begin, size_t end, const Kernel& k, uint8_t* out) {
+        size_t j = begin;
+#ifdef HILLSHADE_AVX2
+        if (hasAvx2()) {
+            // first and last columns use one-sided differences
+            for (; j < end && j < 1; ++j) out[j] = shadePixel(dxAt(mid, j, ncols, fx1, fx2), (down[j] - up[j]) * fy, k);
+            if (j < end) j = shadeSpanAvx2(up, mid, down, fy, fx2, j, min(end, ncols - 1), k, out);
+        }
+#endif
+        for (; j < end; ++j) {
+            out[j] = shadePixel(dxAt(mid, j, ncols, fx1, fx2), (down[j] - up[j]) * fy, k);
+        }
+    }
+
+    // source cell and weight of a bilinear sample, clamped to the grid
+    void clampedAxis(double position, size_t n, size_t& i0, size_t& i1, float& w) {
+        double p = min(max(position, 0.0), static_cast<double>(n - 1));
+        i0 = static_cast<size_t>(p);
+        i1 = min(i0 + 1, n - 1);
+        w = static_cast<float>(p - i0);
+    }
+}
+
+
+AscGrid resample_to_mercator(const AscGrid& dem, double cellsize) {
+    const double top = dem.yllcorner + dem.nrows * dem.cellsize;
+    double minX = lonToX(dem.xllcorner + 0.5 * dem.cellsize);
+    double maxX = lonToX(dem.xllcorner + (dem.ncols - 0.5) * dem.cellsize);
+    double maxY = latToY(top - 0.5 * dem.cellsize);
+    double minY = latToY(dem.yllcorner + 0.5 * dem.cellsize);
+
+    AscGrid out;
+    out.ncols = static_cast<size_t>(ceil((maxX - minX) / cellsize));
+    out.nrows = static_cast<size_t>(ceil((maxY - minY) / cellsize));
+    out.cellsize = cellsize;
+    out.xllcorner = minX;
+    out.yllcorner = maxY - out.nrows * cellsize;
+    out.data.resize(out.ncols * out.nrows);
+
+    vector<size_t> c0(out.ncols), c1(out.ncols);
+    vector<float> wc(out.ncols);
+    for (size_t j = 0; j < out.ncols; ++j) {
+        double lon = xToLon(minX + (j + 0.5) * cellsize);
+        clampedAxis((lon - dem.xllcorner) / dem.cellsize - 0.5, dem.ncols, c0[j], c1[j], wc[j]);
+    }
+    auto value = [&](size_t i, size_t j) {
+        float v = dem.at(i, j);
+        return dem.isNodata(v) || std::isnan(v) ? 0.0f : v;
+    };
+
+    parallel_for_bands(out.nrows, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            double lat = yToLat(maxY - (i + 0.5) * cellsize);
+            size_t r0, r1;
+            float wr;
+            clampedAxis((top - lat) / dem.cellsize - 0.5, dem.nrows, r0, r1, wr);
+            float* row = &out.data[i * out.ncols];
+            for (size_t j = 0; j < out.ncols; ++j) {
+                float upper = value(r0, c0[j]) * (1 - wc[j]) + value(r0, c1[j]) * wc[j];
+                float lower = value(r1, c0[j]) * (1 - wc[j]) + value(r1, c1[j]) * wc[j];
+                row[j] = upper * (1 - wr) + lower * wr;
+            }
+        }
+    });
+    return out;
+}
+
+vector<uint8_t> shade_composite(const AscGrid& dem, const ShadeParams& params) {
+    const size_t nrows = dem.nrows, ncols = dem.ncols;
+    const Kernel kernel(params);
+    const float fx1 = static_cast<float>(1 / dem.cellsize), fx2 = static_cast<float>(0.5 / dem.cellsize);
+    vector<uint8_t> image(nrows * ncols);
+
+    size_t rowBlocks = (nrows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    parallel_for_bands(rowBlocks, [&](size_t begin, size_t end, size_t) {
+        for (size_t block = begin; block < end; ++block) {
+            size_t i0 = block * BLOCK_ROWS, i1 = min(i0 + BLOCK_ROWS, nrows);
+            for (size_t j0 = 0; j0 < ncols; j0 += BLOCK_COLS) {
+                size_t j1 = min(j0 + BLOCK_COLS, ncols);
+                for (size_t i = i0; i < i1; ++i) {
+                    // np.gradient: central differences inside, one-sided on the first and last rows
+                    size_t up = i > 0 ? i - 1 : i, down = i + 1 < nrows ? i + 1 : i;
+                    float fy = down - up == 2 ? fx2 : down == up ? 0.0f : fx1;
+                    shadeSpan(&dem.data[up * ncols], &dem.data[i * ncols], &dem.data[down * ncols], fy, fx1, fx2,
+                              ncols, j0, j1, kernel, &image[i * ncols]);
+                }
+            }
+        }
+    });
+    return image;
+}
+
+void mercator_bounds(const AscGrid& frame, double& west, double& south, double& east, double& north) {
+    west = xToLon(frame.xllcorner);
+    south = yToLat(frame.yllcorner);
+    east = xToLon(frame.xllcorner + frame.ncols * frame.cellsize);
+    north = yToLat(frame.yllcorner + frame.nrows * frame.cellsize);
+}
+
+void render_tiles(const vector<uint8_t>& image, const AscGrid& frame, int minZoom, int maxZoom,
+                  TilePackWriter& out) {
+    double west, south, east, north;
+    mercator_bounds(frame, west, south, east, north);
+    const double xOrigin = frame.xllcorner, yOrigin = frame.yllcorner + frame.nrows * frame.cellsize;
+
+    class TileId {
+        public:
+            int z, x, y;
+    };
+    vector<TileId> tiles;
+    for (int z = minZoom; z <= maxZoom; ++z) {
+        int minX, maxY, maxX, minY;
+        lonLatToTile(west, south, z, minX, maxY);
+        lonLatToTile(east, north, z, maxX, minY);
+        for (int x = minX; x <= maxX; ++x) {
+            for (int y = minY; y <= maxY; ++y) tiles.push_back({z, x, y});
+        }
+    }
+
+    // bilinear sample, 0 outside the centres of the border pixels (map_coordinates mode="constant")
+    auto axis = [](double position, size_t n, long& i0, long& i1, float& w) {
+        if (position < 0 || position > static_cast<double>(n - 1)) {
+            i0 = -1;
+            return;
+        }
+        i0 = static_cast<long>(position);
+        i1 = min<long>(i0 + 1, static_cast<long>(n) - 1);
+        w = static_cast<float>(position - i0);
+    };
+    const size_t ncols = frame.ncols;
+
+    parallel_for_bands(tiles.size(), [&](size_t begin, size_t end, size_t) {
+        vector<uint8_t> tile(TILE_SIZE * TILE_SIZE);
+        vector<long> c0(TILE_SIZE), c1(TILE_SIZE), r0(TILE_SIZE), r1(TILE_SIZE);
+        vector<float> wc(TILE_SIZE), wr(TILE_SIZE);
+        for (size_t t = begin; t < end; ++t) {
+            const TileId& id = tiles[t];
+            double span = 2 * PI * EARTH_RADIUS / ldexp(1.0, id.z);
+            double tileWest = -PI * EARTH_RADIUS + id.x * span, tileNorth = PI * EARTH_RADIUS - id.y * span;
+            double resolution = span / TILE_SIZE;
+            for (int k = 0; k < TILE_SIZE; ++k) {
+                axis((tileWest + (k + 0.5) * resolution - xOrigin) / frame.cellsize - 0.5, frame.ncols, c0[k], c1[k], wc[k]);
+                axis((yOrigin - (tileNorth - (k + 0.5) * resolution)) / frame.cellsize - 0.5, frame.nrows, r0[k], r1[k], wr[k]);
+            }
+            for (int a = 0; a < TILE_SIZE; ++a) {
+                uint8_t* row = &tile[a * TILE_SIZE];
+                if (r0[a] < 0) {
+                    fill(row, row + TILE_SIZE, 0);
+                    continue;
+                }
+                const uint8_t* upper = &image[r0[a] * ncols];
+                const uint8_t* lower = &image[r1[a] * ncols];
+                for (int b = 0; b < TILE_SIZE; ++b) {
+                    if (c0[b] < 0) {
+                        row[b] = 0;
+                        continue;
+                    }
+                    float top = upper[c0[b]] * (1 - wc[b]) + upper[c1[b]] * wc[b];
+                    float bottom = lower[c0[b]] * (1 - wc[b]) + lower[c1[b]] * wc[b];
+                    row[b] = static_cast<uint8_t>(top * (1 - wr[a]) + bottom * wr[a]);
+                }
+            }
+            int tmsRow = (1 << id.z) - 1 - id.y;
+            out.add(id.z, id.x, tmsRow, encode_png_gray(tile.data(), TILE_SIZE, TILE_SIZE));
+        }
+    });
+}
@@ -0,0 +1,39 @@
+#ifndef HILLSHADE_H
+#define HILLSHADE_H
+
+#include "../io/AscGrid.h"
+#include "../io/TilePack.h"
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// Same defaults as utils/hillshade.py
+class ShadeParams {
+    public:
+        double azimuth = 315;       // degrees
+        double altitude = 45;       // degrees
+        double z_shades = 2;
+        double z_slopes = 1.4;
+};
+
+// Bilinear resampling of an EPSG:4326 DEM onto an EPSG:3857 grid of `cellsize` metres
+// covering the same cell centres, as utils/hillshade.py resample_to_metric.
+// Both projections are separable, so source rows and columns are computed once per
+// target row and column. Nodata cells count as sea level.
+AscGrid resample_to_mercator(const AscGrid& dem, double cellsize);
+
+// Hillshade and inverted normalised slope averaged into one 0-255 image, the
+// `composite` of utils/hillshade.py. 3x3 stencil with np.gradient's one-sided
+// differences on the borders, run over cache-sized blocks in parallel; an AVX2 kernel
+// is picked at run time when the CPU has it, with a scalar fallback.
+vector<uint8_t> shade_composite(const AscGrid& dem, const ShadeParams& params);
+
+// Every 256x256 web mercator tile of zooms minZoom..maxZoom over the EPSG:3857 grid,
+// bilinearly sampled from the image (0 outside) and encoded as grayscale PNG.
+void render_tiles(const vector<uint8_t>& image, const AscGrid& frame, int minZoom, int maxZoom,
+                  TilePackWriter& out);
+
+// lon/lat bounds of an EPSG:3857 grid
+void mercator_bounds(const AscGrid& frame, double& west, double& south, double& east, double& north);
+
+#endif // HILLSHADE_H
@@ -0,0 +1,113 @@
+#include "LocalDem.h"
+
+#include "../data/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+    // Python's repr of the float32 value widened to a double, which is what the
+    // f-string of a numpy float32 printed (45.6 -> "45.599998474121094", 7 -> "7.0")
+    string pythonRepr(float v) {
+        double d = v;
+        char buffer[64];
+        for (int decimals = 0; decimals <= 20; ++decimals) {
+            snprintf(buffer, sizeof(buffer), "%.*f", decimals, d);
+            if (strtod(buffer, nullptr) == d) {
+                return decimals == 0 ? string(buffer) + ".0" : string(buffer);
+            }
+        }
+        return buffer;
+    }
+}
+
+
+string local_tm_proj4(double lon, double lat) {
+    return "+proj=tmerc +lat_0=" + pythonRepr(static_cast<float>(lat)) +
+           " +lon_0=" + pythonRepr(static_cast<float>(lon)) +
+           " +k=1 +x_0=0 +y_0=0 +ellps=WGS84 +units=m +no_defs";
+}
+
+float dem_value_at(const AscGrid& dem, double lon, double lat) {
+    float top = static_cast<float>(dem.yllcorner + dem.nrows * dem.cellsize);
+    long i = static_cast<long>((top - static_cast<float>(lat)) / static_cast<float>(dem.cellsize));
+    long j = static_cast<long>((static_cast<float>(lon) - static_cast<float>(dem.xllcorner)) / static_cast<float>(dem.cellsize));
+    if (i < 0 || j < 0 || i >= static_cast<long>(dem.nrows) || j >= static_cast<long>(dem.ncols)) {
+        return 0;
+    }
+    return dem.at(i, j);
+}
+
+float airfield_elevation(const AscGrid& dem, double lon, double lat) {
+    float elevation = dem_value_at(dem, lon, lat);
+    if (dem.isNodata(elevation)) throw runtime_error("no elevation under the airfield (void or missing tile).");
+    return elevation;
+}
+
+void tm_square_bounds(const TransverseMercator& tm, float radius, double& west, double& south,
+                      double& east, double& north) {
+    const int steps = 16;
+    west = south = 1e9;
+    east = north = -1e9;
+    for (int k = 0; k <= steps; ++k) {
+        double t = -radius + 2.0 * radius * k / steps;
+        const double x[4] = {t, t, -radius, radius}, y[4] = {-radius, radius, t, t};
+        for (int e = 0; e < 4; ++e) {
+            double lon, lat;
+            tm.inverse(x[e], y[e], lon, lat);
+            west = min(west, lon);
+            east = max(east, lon);
+            south = min(south, lat);
+            north = max(north, lat);
+        }
+    }
+}
+
+AscGrid extract_tm_dem(const AscGrid& dem, const TransverseMercator& tm, float radius, float cellsize) {
+    AscGrid out;
+    out.ncols = out.nrows = static_cast<size_t>(ceil(2 * radius / cellsize));
+    out.xllcorner = out.yllcorner = -radius;
+    out.cellsize = cellsize;
+    out.data.resize(out.ncols * out.nrows);
+
+    // index arithmetic in float32 like the Python code, so the grids are identical
+    const float xll = static_cast<float>(dem.xllcorner), cs = static_cast<float>(dem.cellsize);
+    const float top = static_cast<float>(dem.yllcorner) + static_cast<float>(dem.nrows) * cs;
+    const double lastRow = dem.nrows - 1.0, lastCol = dem.ncols - 1.0;
+    auto value = [&](size_t i, size_t j) -> double {
+        float v = dem.at(i, j);
+        return dem.isNodata(v) || std::isnan(v) ? 0.0 : v;
+    };
+
+    parallel_for_bands(out.nrows, [&](size_t begin, size_t end, size_t) {
+        vector<double> x(out.ncols), y(out.ncols), lon(out.ncols), lat(out.ncols);
+        for (size_t j = 0; j < out.ncols; ++j) x[j] = -radius + (j + 0.5f) * cellsize;
+        for (size_t i = begin; i < end; ++i) {
+            fill(y.begin(), y.end(), radius - (i + 0.5f) * cellsize);
+            tm.inverse(x.data(), y.data(), lon.data(), lat.data(), out.ncols);
+
+            float* row = &out.data[i * out.ncols];
+            for (size_t j = 0; j < out.ncols; ++j) {
+                double r = (top - static_cast<float>(lat[j])) / cs - 0.5f;
+                double c = (static_cast<float>(lon[j]) - xll) / cs - 0.5f;
+                // map_coordinates(order=1, mode="constant"): 0 beyond the outer cell centres
+                if (r < 0 || c < 0 || r > lastRow || c > lastCol) {
+                    row[j] = 0;
+                    continue;
+                }
+                size_t r0 = static_cast<size_t>(r), c0 = static_cast<size_t>(c);
+                size_t r1 = min(r0 + 1, dem.nrows - 1), c1 = min(c0 + 1, dem.ncols - 1);
+                double wr = r - r0, wc = c - c0;
+                double upper = value(r0, c0) * (1 - wc) + value(r0, c1) * wc;
+                double lower = value(r1, c0) * (1 - wc) + value(r1, c1) * wc;
+                row[j] = nearbyint(static_cast<float>(upper * (1 - wr) + lower * wr));
+            }
+        }
+    });
+    return out;
+}
@@ -0,0 +1,32 @@
+#ifndef LOCALDEM_H
+#define LOCALDEM_H
+
+#include "../io/AscGrid.h"
+#include "TransverseMercator.h"
+#include <string>
+using namespace std;
+
+// What src/extract_project_tm.py did for each airfield, in memory.
+
+// "+proj=tmerc +lat_0=.. +lon_0=.." centred on the airfield, written exactly as the
+// Python code did (float32 coordinates), so crs.txt is unchanged
+string local_tm_proj4(double lon, double lat);
+
+// DEM value of the cell containing (lon, lat)
+float dem_value_at(const AscGrid& dem, double lon, double lat);
+
+// dem_value_at for the home of an airfield, which sizes its window: throws when the DEM
+// has no value there (nodata, i.e. a void or a missing tile of an .hgt folder)
+float airfield_elevation(const AscGrid& dem, double lon, double lat);
+
+// lon/lat bounds of the TM square of half-width `radius` metres around the projection
+// origin, from points along its edges
+void tm_square_bounds(const TransverseMercator& tm, float radius, double& west, double& south,
+                      double& east, double& north);
+
+// Square TM grid of half-width `radius` metres centred on the projection origin,
+// bilinearly sampled from the EPSG:4326 DEM (0 outside it) and rounded to whole metres.
+// The cells of a target row share their northing, which the row inverse works out once.
+AscGrid extract_tm_dem(const AscGrid& dem, const TransverseMercator& tm, float radius, float cellsize);
+
+#endif // LOCALDEM_H
@@ -0,0 +1,374 @@
+#include "Sectors.h"
+
+#include "../data/Parallel.h"
+#include "../io/AscGrid.h"
+#include "Contours.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+    // A cell side on the border of a sector, oriented with the sector's cell on its left.
+    // Corners are numbered R * (ncols + 1) + C, R growing southwards.
+    class BorderEdge {
+        public:
+            uint32_t sector;
+            uint64_t from;
+            uint64_t to;
+            uint64_t cell;
+
+            bool operator<(const BorderEdge& other) const {
+                return sector != other.sector ? sector < other.sector : from < other.from;
+            }
+    };
+
+    // sector index of every cell, -1 for nodata
+    vector<int32_t> indexGrid(const AscGrid& grid, const vector<float>& ids) {
+        vector<int32_t> index(grid.data.size(), -1);
+        for (size_t k = 0; k < grid.data.size(); ++k) {
+            float v = grid.data[k];
+            if (grid.isNodata(v) || std::isnan(v)) continue;
+            auto it = lower_bound(ids.begin(), ids.end(), v);
+            if (it != ids.end() && *it == v) index[k] = static_cast<int32_t>(it - ids.begin());
+        }
+        return index;
+    }
+
+    bool contains(const Ring& ring, double px, double py) {
+        bool inside = false;
+        size_t n = ring.x.size();
+        for (size_t a = 0, b = n - 1; a < n; b = a++) {
+            if ((ring.y[a] > py) != (ring.y[b] > py) &&
+                px < (ring.x[b] - ring.x[a]) * (py - ring.y[a]) / (ring.y[b] - ring.y[a]) + ring.x[a]) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+    double signedArea(const Ring& ring) {
+        double area = 0;
+        for (size_t k = 0; k + 1 < ring.x.size(); ++k) {
+            area += ring.x[k] * ring.y[k + 1] - ring.x[k + 1] * ring.y[k];
+        }
+        return area / 2;
+    }
+
+    class Segment {
+        public:
+            double x0, y0, x1, y1;
+    };
+
+    double orientation(double ax, double ay, double bx, double by, double cx, double cy) {
+        return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    }
+
+    // true if two segments of the rings cross each other, touching at a vertex is allowed
+    bool ringsCross(const vector<SectorPolygon>& polygons) {
+        vector<Segment> segments;
+        auto add = [&](const Ring& ring) {
+            for (size_t k = 0; k + 1 < ring.x.size(); ++k) {
+                Segment seg = {ring.x[k], ring.y[k], ring.x[k + 1], ring.y[k + 1]};
+                if (seg.x0 > seg.x1) { swap(seg.x0, seg.x1); swap(seg.y0, seg.y1); }
+                segments.push_back(seg);
+            }
+        };
+        for (const SectorPolygon& polygon : polygons) {
+            add(polygon.exterior);
+            for (const Ring& hole : polygon.holes) add(hole);
+        }
+        sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.x0 < b.x0; });
+
+        // sweep along x
+        for (size_t a = 0; a < segments.size(); ++a) {
+            const Segment& s = segments[a];
+            for (size_t b = a + 1; b < segments.size() && segments[b].x0 <= s.x1; ++b) {
+                const Segment& t = segments[b];
+                if (max(s.y0, s.y1) < min(t.y0, t.y1) || max(t.y0, t.y1) < min(s.y0, s.y1)) continue;
+                double d1 = orientation(s.x0, s.y0, s.x1, s.y1, t.x0, t.y0);
+                double d2 = orientation(s.x0, s.y0, s.x1, s.y1, t.x1, t.y1);
+                double d3 = orientation(t.x0, t.y0, t.x1, t.y1, s.x0, s.y0);
+                double d4 = orientation(t.x0, t.y0, t.x1, t.y1, s.x1, s.y1);
+                if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) {
+                    return true;
+                }
+                // a vertex lying inside the other segment
+                if ((d1 == 0 && d2 != 0 && (t.x0 - s.x0) * (t.x0 - s.x1) + (t.y0 - s.y0) * (t.y0 - s.y1) < 0) ||
+                    (d2 == 0 && d1 != 0 && (t.x1 - s.x0) * (t.x1 - s.x1) + (t.y1 - s.y0) * (t.y1 - s.y1) < 0) ||
+                    (d3 == 0 && d4 != 0 && (s.x0 - t.x0) * (s.x0 - t.x1) + (s.y0 - t.y0) * (s.y0 - t.y1) < 0) ||
+                    (d4 == 0 && d3 != 0 && (s.x1 - t.x0) * (s.x1 - t.x1) + (s.y1 - t.y0) * (s.y1 - t.y1) < 0)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // true if a simplified exterior moved inside another polygon, or a hole out of its own
+    bool shellsNested(const vector<SectorPolygon>& polygons) {
+        auto probe = [](const Ring& ring, double& px, double& py) {
+            px = (ring.x[0] + ring.x[1]) / 2;
+            py = (ring.y[0] + ring.y[1]) / 2;
+        };
+        double px, py;
+        for (size_t a = 0; a < polygons.size(); ++a) {
+            for (const Ring& hole : polygons[a].holes) {
+                probe(hole, px, py);
+                if (!contains(polygons[a].exterior, px, py)) return true;
+            }
+            probe(polygons[a].exterior, px, py);
+            for (size_t b = 0; b < polygons.size(); ++b) {
+                if (b == a || !contains(polygons[b].exterior, px, py)) continue;
+                bool inHole = false;
+                for (const Ring& hole : polygons[b].holes) inHole = inHole || contains(hole, px, py);
+                if (!inHole) return true;
+            }
+        }
+        return false;
+    }
+
+    // Chains the border edges of one sector into rings and groups them into polygons.
+    void traceSector(const AscGrid& grid, const vector<BorderEdge>& edges, size_t begin, size_t end,
+                     double minArea, double simplifyTolerance, Sector& sector) {
+        const uint64_t corners_per_row = grid.ncols + 1;
+        vector<char> used(end - begin, 0);
+        vector<Ring> exteriors, holes;
+        vector<uint64_t> corners, cells;
+        unordered_map<uint64_t, size_t> position;
+
+        auto direction = [&](const BorderEdge& e, long long& dc, long long& dr) {
+            dc = static_cast<long long>(e.to % corners_per_row) - static_cast<long long>(e.from % corners_per_row);
+            dr = static_cast<long long>(e.to / corners_per_row) - static_cast<long long>(e.from / corners_per_row);
+        };
+
+        // closes the loop corners[from..] back onto corners[from]
+        auto emitRing = [&](size_t from, uint64_t cell) {
+            Ring ring;
+            size_t m = corners.size() - from;
+            // keep only the corners where the border turns
+            for (size_t k = 0; k < m; ++k) {
+                uint64_t prev = corners[from + (k + m - 1) % m], cur = corners[from + k], nxt = corners[from + (k + 1) % m];
+                long long c0 = prev % corners_per_row, r0 = prev / corners_per_row;
+                long long c1 = cur % corners_per_row, r1 = cur / corners_per_row;
+                long long c2 = nxt % corners_per_row, r2 = nxt / corners_per_row;
+                if ((c1 - c0) * (r2 - r1) == (r1 - r0) * (c2 - c1)) continue;
+                ring.x.push_back(grid.xllcorner + c1 * grid.cellsize);
+                ring.y.push_back(grid.yllcorner + (static_cast<double>(grid.nrows) - r1) * grid.cellsize);
+            }
+            if (ring.x.size() < 3) return;
+            ring.x.push_back(ring.x[0]);
+            ring.y.push_back(ring.y[0]);
+            ring.area = signedArea(ring);
+            ring.sample_x = grid.xllcorner + (cell % grid.ncols + 0.5) * grid.cellsize;
+            ring.sample_y = grid.yllcorner + (grid.nrows - cell / grid.ncols - 0.5) * grid.cellsize;
+
+            if (fabs(ring.area) < minArea) return;
+            if (ring.area > 0) exteriors.push_back(move(ring));
+            else holes.push_back(move(ring));
+        };
+
+        for (size_t first = begin; first < end; ++first) {
+            if (used[first - begin]) continue;
+            used[first - begin] = 1;
+            // the walk so far, with the cell on the left of the edge leaving each corner
+            corners.assign(1, edges[first].from);
+            cells.assign(1, edges[first].cell);
+            position.clear();
+            position[edges[first].from] = 0;
+            size_t current = first;
+
+            while (true) {
+                uint64_t corner = edges[current].to;
+                BorderEdge key;
+                key.sector = edges[first].sector;
+                key.from = corner;
+                size_t next = end;
+                long long dc, dr, dc2, dr2;
+                direction(edges[current], dc, dr);
+                for (size_t k = lower_bound(edges.begin() + begin, edges.begin() + end, key) - edges.begin();
+                     k < end && edges[k].from == corner; ++k) {
+                    if (used[k - begin]) continue;
+                    // two ways out where the sector touches itself diagonally: turning left keeps
+                    // going around the same cell, so diagonal cells are not connected
+                    direction(edges[k], dc2, dr2);
+                    if (next == end || dc * (-dr2) - (-dr) * dc2 > 0) next = k;
+                }
+
+                // the walk comes back to a corner it already went through where a hole touches
+                // the outline diagonally: cut the loop off as its own ring so that rings stay simple
+                auto seen = position.find(corner);
+                if (seen != position.end()) {
+                    size_t from = seen->second;
+                    emitRing(from, cells[from]);
+                    for (size_t k = from + 1; k < corners.size(); ++k) position.erase(corners[k]);
+                    corners.resize(from + 1);
+                    cells.resize(from + 1);
+                    if (next == end) break;
+                    cells[from] = edges[next].cell;
+                } else {
+                    if (next == end) break;
+                    position[corner] = corners.size();
+                    corners.push_back(corner);
+                    cells.push_back(edges[next].cell);
+                }
+                used[next - begin] = 1;
+                current = next;
+            }
+        }
+
+        sector.polygons.resize(exteriors.size());
+        for (size_t k = 0; k < exteriors.size(); ++k) {
+            sector.polygons[k].exterior = move(exteriors[k]);
+        }
+        for (Ring& hole : holes) {
+            // innermost exterior around the hole
+            size_t owner = sector.polygons.size();
+            for (size_t k = 0; k < sector.polygons.size(); ++k) {
+                const Ring& exterior = sector.polygons[k].exterior;
+                if (contains(exterior, hole.sample_x, hole.sample_y) &&
+                    (owner == sector.polygons.size() || exterior.area < sector.polygons[owner].exterior.area)) {
+                    owner = k;
+                }
+            }
+            if (owner < sector.polygons.size()) {
+                sector.polygons[owner].holes.push_back(move(hole));
+            }
+        }
+
+        // rings are simplified independently, so they may end up crossing each other:
+        // halve the tolerance until they do not
+        vector<SectorPolygon> exact = sector.polygons;
+        for (double tolerance = simplifyTolerance; tolerance > 0; tolerance /= 2) {
+            for (SectorPolygon& polygon : sector.polygons) {
+                simplify_polyline(polygon.exterior.x, polygon.exterior.y, tolerance);
+                for (Ring& hole : polygon.holes) {
+                    simplify_polyline(hole.x, hole.y, tolerance);
+                }
+            }
+            if (!ringsCross(sector.polygons) && !shellsNested(sector.polygons)) return;
+            sector.polygons = exact;
+            if (tolerance < grid.cellsize / 4) return;
+        }
+    }
+
+    vector<float> sectorIds(const AscGrid& grid) {
+        vector<float> ids;
+        for (float v : grid.data) {
+            if (!grid.isNodata(v) && !std::isnan(v)) ids.push_back(v);
+        }
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        return ids;
+    }
+}
+
+
+vector<Sector> trace_sectors(const AscGrid& grid, double minArea, double simplifyTolerance) {
+    vector<float> ids = sectorIds(grid);
+    vector<int32_t> index = indexGrid(grid, ids);
+    const size_t nrows = grid.nrows, ncols = grid.ncols;
+    const uint64_t cpr = ncols + 1;
+
+    vector<BorderEdge> edges;
+    auto at = [&](long long i, long long j) -> int32_t {
+        if (i < 0 || j < 0 || i >= static_cast<long long>(nrows) || j >= static_cast<long long>(ncols)) return -1;
+        return index[i * ncols + j];
+    };
+    for (size_t i = 0; i < nrows; ++i) {
+        for (size_t j = 0; j < ncols; ++j) {
+            int32_t s = index[i * ncols + j];
+            if (s < 0) continue;
+            uint64_t cell = i * ncols + j;
+            uint32_t sector = static_cast<uint32_t>(s);
+            uint64_t ul = i * cpr + j, ur = ul + 1, ll = ul + cpr, lr = ll + 1;
+            if (at(i - 1, j) != s) edges.push_back({sector, ur, ul, cell});
+            if (at(i + 1, j) != s) edges.push_back({sector, ll, lr, cell});
+            if (at(i, j - 1) != s) edges.push_back({sector, ul, ll, cell});
+            if (at(i, j + 1) != s) edges.push_back({sector, lr, ur, cell});
+        }
+    }
+    sort(edges.begin(), edges.end());
+
+    vector<Sector> sectors(ids.size());
+    vector<size_t> starts(ids.size() + 1, edges.size());
+    for (size_t k = edges.size(); k-- > 0;) starts[edges[k].sector] = k;
+    for (size_t s = ids.size(); s-- > 0;) starts[s] = min(starts[s], starts[s + 1]);
+
+    parallel_for_bands(ids.size(), [&](size_t begin, size_t end, size_t) {
+        for (size_t s = begin; s < end; ++s) {
+            sectors[s].id = static_cast<int>(ids[s]);
+            traceSector(grid, edges, starts[s], starts[s + 1], minArea, simplifyTolerance, sectors[s]);
+        }
+    });
+    // all of their rings were under minArea: not on the map, so not coloured either
+    sectors.erase(remove_if(sectors.begin(), sectors.end(),
+                            [](const Sector& sector) { return sector.polygons.empty(); }),
+                  sectors.end());
+    return sectors;
+}
+
+vector<pair<size_t, size_t>> sector_adjacency(const AscGrid& grid, const vector<Sector>& sectors, size_t gapCells) {
+    vector<float> ids;
+    for (const Sector& sector : sectors) ids.push_back(static_cast<float>(sector.id));
+    vector<int32_t> index = indexGrid(grid, ids);
+    const size_t nrows = grid.nrows, ncols = grid.ncols;
+
+    vector<pair<size_t, size_t>> pairs;
+    auto scan = [&](size_t count, size_t length, size_t outerStride, size_t innerStride) {
+        for (size_t a = 0; a < count; ++a) {
+            int32_t last = -1;
+            size_t lastPos = 0;
+            for (size_t b = 0; b < length; ++b) {
+                int32_t s = index[a * outerStride + b * innerStride];
+                if (s < 0) continue;
+                if (last >= 0 && s != last && b - lastPos - 1 <= gapCells) {
+                    pairs.emplace_back(min(s, last), max(s, last));
+                }
+                last = s;
+                lastPos = b;
+            }
+        }
+    };
+    scan(nrows, ncols, ncols, 1);    // rows
+    scan(ncols, nrows, 1, ncols);    // columns
+
+    sort(pairs.begin(), pairs.end());
+    pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+    return pairs;
+}
+
+void color_sectors(vector<Sector>& sectors, const vector<pair<size_t, size_t>>& adjacency, int nbColors) {
+    size_t n = sectors.size();
+    vector<vector<size_t>> neighbours(n);
+    for (const auto& edge : adjacency) {
+        neighbours[edge.first].push_back(edge.second);
+        neighbours[edge.second].push_back(edge.first);
+    }
+
+    vector<int> colors(n, -1);
+    vector<set<int>> saturation(n);
+    int nextFallback = nbColors;
+    for (size_t step = 0; step < n; ++step) {
+        // most constrained uncoloured sector, ties broken by degree
+        size_t best = n;
+        for (size_t s = 0; s < n; ++s) {
+            if (colors[s] >= 0) continue;
+            if (best == n || saturation[s].size() > saturation[best].size() ||
+                (saturation[s].size() == saturation[best].size() && neighbours[s].size() > neighbours[best].size())) {
+                best = s;
+            }
+        }
+        int color = 0;
+        while (color < nbColors && saturation[best].count(color)) ++color;
+        if (color == nbColors) color = nextFallback++;
+        colors[best] = color;
+        for (size_t nb : neighbours[best]) saturation[nb].insert(color);
+    }
+    for (size_t s = 0; s < n; ++s) sectors[s].color = colors[s];
+}
@@ -0,0 +1,49 @@
+#ifndef SECTORS_H
+#define SECTORS_H
+
+#include "../io/AscGrid.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// A closed ring in map coordinates, first point == last point.
+class Ring {
+    public:
+        vector<double> x;
+        vector<double> y;
+        double area = 0;        // signed, > 0 for counter-clockwise
+        double sample_x = 0;    // centre of a cell of the sector touching the ring,
+        double sample_y = 0;    // used to find which outer ring a hole belongs to
+};
+
+class SectorPolygon {
+    public:
+        Ring exterior;
+        vector<Ring> holes;
+};
+
+class Sector {
+    public:
+        int id;                 // value in the sectors raster
+        int color = 0;
+        vector<SectorPolygon> polygons;
+};
+
+// Polygons of every sector of a sector-id raster, traced along the cell edges in one pass
+// over the grid. Rings are oriented (exteriors counter-clockwise), holes are attached to
+// their exterior, rings smaller than minArea (map units²) are dropped and the remaining
+// ones simplified with Douglas-Peucker (tolerance in map units). Sectors left without a
+// ring are not returned.
+vector<Sector> trace_sectors(const AscGrid& grid, double minArea, double simplifyTolerance);
+
+// Pairs of indices into `sectors` whose cells are 4-neighbours, or only separated along a
+// row or column by at most gapCells nodata/ground cells (or cells of sectors not in
+// `sectors`). Two scans of the grid.
+vector<pair<size_t, size_t>> sector_adjacency(const AscGrid& grid, const vector<Sector>& sectors, size_t gapCells);
+
+// DSATUR greedy colouring. Sectors that cannot get one of the nbColors colours get the
+// next free colour index (>= nbColors), as the Python fallback did.
+void color_sectors(vector<Sector>& sectors, const vector<pair<size_t, size_t>>& adjacency, int nbColors);
+
+#endif // SECTORS_H
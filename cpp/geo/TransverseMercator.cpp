@@ -0,0 +1,201 @@
+#include "TransverseMercator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+using namespace std;
+
+namespace {
+    const double WGS84_A = 6378137.0;
+    const double WGS84_F = 1.0 / 298.257223563;
+    const double DEG = 3.14159265358979323846 / 180.0;
+
+    // tan(conformal latitude) from tan(geographic latitude)
+    inline double taupf(double tau, double e) {
+        double tau1 = hypot(1.0, tau);
+        double sig = sinh(e * atanh(e * tau / tau1));
+        return hypot(1.0, sig) * tau - sig * tau1;
+    }
+
+    // inverse of taupf, Newton iterations (converges in 2 or 3 steps)
+    inline double tauf(double taup, double e) {
+        double e2m = 1.0 - e * e;
+        double tau = taup / e2m;
+        for (int it = 0; it < 5; ++it) {
+            double taupa = taupf(tau, e);
+            double dtau = (taup - taupa) * (1.0 + e2m * tau * tau) /
+                          (e2m * hypot(1.0, tau) * hypot(1.0, taupa));
+            tau += dtau;
+            if (fabs(dtau) < 1e-14 * max(1.0, fabs(tau))) break;
+        }
+        return tau;
+    }
+
+    // sum over j of c[j] sin(2 (j + 1) zeta), zeta = xi + i eta, by Clenshaw summation from the
+    // sines and cosines of 2 xi and 2 eta: the real part is the sum of c[j] sin(2k xi) cosh(2k eta),
+    // the imaginary part that of c[j] cos(2k xi) sinh(2k eta), k = j + 1 (the Krüger series)
+    inline void kruger(const double* c, double s2xi, double c2xi, double sh2eta, double ch2eta,
+                       double& re, double& im) {
+        // 2 cos(2 zeta)
+        const double ar = 2 * c2xi * ch2eta, ai = -2 * s2xi * sh2eta;
+        double br = 0, bi = 0, br1 = 0, bi1 = 0;
+        for (int j = 5; j >= 0; --j) {
+            double tr = ar * br - ai * bi - br1 + c[j];
+            double ti = ar * bi + ai * br - bi1;
+            br1 = br;
+            bi1 = bi;
+            br = tr;
+            bi = ti;
+        }
+        // times sin(2 zeta)
+        const double sr = s2xi * ch2eta, si = c2xi * sh2eta;
+        re = sr * br - si * bi;
+        im = sr * bi + si * br;
+    }
+}
+
+
+TransverseMercator::TransverseMercator(double lat0, double lon0, double k0, double x0, double y0)
+    : lat_0(lat0), lon_0(lon0), k_0(k0), x_0(x0), y_0(y0) {
+    setup();
+}
+
+void TransverseMercator::setup() {
+    double f = WGS84_F;
+    this->e = sqrt(f * (2 - f));
+    double n = f / (2 - f);
+    double n2 = n * n, n3 = n2 * n, n4 = n3 * n, n5 = n4 * n, n6 = n5 * n;
+
+    double A = WGS84_A / (1 + n) * (1 + n2 / 4 + n4 / 64 + n6 / 256);
+    this->kA = this->k_0 * A;
+
+    alpha[0] = n / 2 - 2 * n2 / 3 + 5 * n3 / 16 + 41 * n4 / 180 - 127 * n5 / 288 + 7891 * n6 / 37800;
+    alpha[1] = 13 * n2 / 48 - 3 * n3 / 5 + 557 * n4 / 1440 + 281 * n5 / 630 - 1983433 * n6 / 1935360;
+    alpha[2] = 61 * n3 / 240 - 103 * n4 / 140 + 15061 * n5 / 26880 + 167603 * n6 / 181440;
+    alpha[3] = 49561 * n4 / 161280 - 179 * n5 / 168 + 6601661 * n6 / 7257600;
+    alpha[4] = 34729 * n5 / 80640 - 3418889 * n6 / 1995840;
+    alpha[5] = 212378941 * n6 / 319334400;
+
+    beta[0] = n / 2 - 2 * n2 / 3 + 37 * n3 / 96 - n4 / 360 - 81 * n5 / 512 + 96199 * n6 / 604800;
+    beta[1] = n2 / 48 + n3 / 15 - 437 * n4 / 1440 + 46 * n5 / 105 - 1118711 * n6 / 3870720;
+    beta[2] = 17 * n3 / 480 - 37 * n4 / 840 - 209 * n5 / 4480 + 5569 * n6 / 90720;
+    beta[3] = 4397 * n4 / 161280 - 11 * n5 / 504 - 830251 * n6 / 7257600;
+    beta[4] = 4583 * n5 / 161280 - 108847 * n6 / 3991680;
+    beta[5] = 20648693 * n6 / 638668800;
+
+    // xi of lat_0 on the central meridian, subtracted so that lat_0 maps to y_0
+    double taup = taupf(tan(this->lat_0 * DEG), this->e);
+    double xip = atan(taup);
+    double xi = xip;
+    for (int j = 0; j < 6; ++j) {
+        xi += alpha[j] * sin(2 * (j + 1) * xip);
+    }
+    this->xi_0 = xi;
+}
+
+TransverseMercator TransverseMercator::fromProj4(const string& proj4) {
+    double lat0 = 0, lon0 = 0, k0 = 1, x0 = 0, y0 = 0;
+    bool isTmerc = false;
+
+    istringstream iss(proj4);
+    string token;
+    while (iss >> token) {
+        if (token.empty() || token[0] != '+') continue;
+        size_t eq = token.find('=');
+        string key = token.substr(1, eq == string::npos ? string::npos : eq - 1);
+        string value = eq == string::npos ? "" : token.substr(eq + 1);
+
+        if (key == "proj") {
+            isTmerc = (value == "tmerc" || value == "etmerc");
+        } else if (key == "lat_0") {
+            lat0 = stod(value);
+        } else if (key == "lon_0") {
+            lon0 = stod(value);
+        } else if (key == "k" || key == "k_0") {
+            k0 = stod(value);
+        } else if (key == "x_0") {
+            x0 = stod(value);
+        } else if (key == "y_0") {
+            y0 = stod(value);
+        } else if ((key == "ellps" || key == "datum") && value != "WGS84") {
+            throw runtime_error("Only the WGS84 ellipsoid is supported, got +" + key + "=" + value);
+        }
+    }
+    if (!isTmerc) {
+        throw runtime_error("CRS is not a transverse Mercator projection: " + proj4);
+    }
+    return TransverseMercator(lat0, lon0, k0, x0, y0);
+}
+
+TransverseMercator TransverseMercator::fromFile(const string& crsFile) {
+    ifstream file(crsFile);
+    if (!file.is_open()) {
+        throw runtime_error("Compute could not open CRS file " + crsFile);
+    }
+    string line;
+    getline(file, line);
+    return fromProj4(line);
+}
+
+void TransverseMercator::forward(double lon, double lat, double& x, double& y) const {
+    fromTaup(lon, taupf(tan(lat * DEG), this->e), x, y);
+}
+
+void TransverseMercator::inverse(double x, double y, double& lon, double& lat) const {
+    double xi = (y - this->y_0) / this->kA + this->xi_0;
+    fromXi(x, xi, sin(2 * xi), cos(2 * xi), lon, lat);
+}
+
+void TransverseMercator::forward(const double* lon, const double* lat, double* x, double* y, size_t n) const {
+    double last = NAN, taup = 0;
+    for (size_t k = 0; k < n; ++k) {
+        if (!(lat[k] == last)) {
+            last = lat[k];
+            taup = taupf(tan(last * DEG), this->e);
+        }
+        fromTaup(lon[k], taup, x[k], y[k]);
+    }
+}
+
+void TransverseMercator::inverse(const double* x, const double* y, double* lon, double* lat, size_t n) const {
+    double last = NAN, xi = 0, s2 = 0, c2 = 0;
+    for (size_t k = 0; k < n; ++k) {
+        if (!(y[k] == last)) {
+            last = y[k];
+            xi = (last - this->y_0) / this->kA + this->xi_0;
+            s2 = sin(2 * xi);
+            c2 = cos(2 * xi);
+        }
+        fromXi(x[k], xi, s2, c2, lon[k], lat[k]);
+    }
+}
+
+void TransverseMercator::fromTaup(double lon, double taup, double& x, double& y) const {
+    double lam = (lon - this->lon_0) * DEG;
+    double sl = sin(lam), cl = cos(lam);
+    double r = hypot(taup, cl);
+    double xip = atan2(taup, cl);
+    double sh = sl / r, etap = asinh(sh), ch = hypot(1.0, sh);
+    // sines and cosines of 2 xi' and 2 eta' from those of xi' and eta', no more calls
+    double sx = taup / r, cx = cl / r;
+    double re, im;
+    kruger(alpha, 2 * sx * cx, cx * cx - sx * sx, 2 * sh * ch, ch * ch + sh * sh, re, im);
+    x = this->x_0 + this->kA * (etap + im);
+    y = this->y_0 + this->kA * (xip + re - this->xi_0);
+}
+
+void TransverseMercator::fromXi(double x, double xi, double s2xi, double c2xi, double& lon, double& lat) const {
+    double eta = (x - this->x_0) / this->kA;
+    double e2 = exp(2 * eta), sh2 = (e2 - 1 / e2) / 2, ch2 = (e2 + 1 / e2) / 2;
+    double re, im;
+    kruger(beta, s2xi, c2xi, sh2, ch2, re, im);
+    double xip = xi - re, etap = eta - im;
+    double s = sinh(etap), c = cos(xip);
+    double taup = sin(xip) / hypot(s, c);
+    lat = atan(tauf(taup, this->e)) / DEG;
+    lon = this->lon_0 + atan2(s, c) / DEG;
+}
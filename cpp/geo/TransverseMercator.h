@@ -0,0 +1,49 @@
+#ifndef TRANSVERSEMERCATOR_H
+#define TRANSVERSEMERCATOR_H
+
+#include <cstddef>
+#include <string>
+using namespace std;
+
+// Transverse Mercator on the WGS84 ellipsoid, Krüger series to 6th order in n
+// (same formulation as PROJ's default tmerc), accurate to the mm within a few
+// thousand km of the central meridian.
+// Only the parameters written by extract_project_tm.py are understood:
+// +proj=tmerc +lat_0 +lon_0 +k (or +k_0) +x_0 +y_0 +ellps=WGS84 / +datum=WGS84
+class TransverseMercator {
+    public:
+        double lat_0 = 0, lon_0 = 0, k_0 = 1, x_0 = 0, y_0 = 0;
+
+        TransverseMercator(double lat0 = 0, double lon0 = 0, double k0 = 1, double x0 = 0, double y0 = 0);
+
+        static TransverseMercator fromProj4(const string& proj4);
+
+        static TransverseMercator fromFile(const string& crsFile);
+
+        // degrees -> metres
+        void forward(double lon, double lat, double& x, double& y) const;
+
+        // metres -> degrees
+        void inverse(double x, double y, double& lon, double& lat) const;
+
+        // n points at once, the same results as the scalar versions. The terms of the latitude
+        // (forward) or of the northing (inverse) are computed once for a run of equal values,
+        // as along the rows of a grid.
+        void forward(const double* lon, const double* lat, double* x, double* y, size_t n) const;
+
+        void inverse(const double* x, const double* y, double* lon, double* lat, size_t n) const;
+
+    private:
+        double e, kA, xi_0;
+        double alpha[6], beta[6];
+
+        void setup();
+
+        // forward once tan of the conformal latitude is known
+        void fromTaup(double lon, double taup, double& x, double& y) const;
+
+        // inverse once xi and the sine and cosine of 2 xi are known
+        void fromXi(double x, double xi, double s2xi, double c2xi, double& lon, double& lat) const;
+};
+
+#endif // TRANSVERSEMERCATOR_H
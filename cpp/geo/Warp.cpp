@@ -0,0 +1,115 @@
+#include "Warp.h"
+
+#include "../data/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+using namespace std;
+
+namespace {
+    // read_asc of src/warp.py: drop border rows and columns that are entirely nodata
+    void trimmedWindow(const AscGrid& grid, size_t& top, size_t& bottom, size_t& left, size_t& right) {
+        auto rowEmpty = [&](size_t i) {
+            for (size_t j = left; j < right; ++j) if (grid.at(i, j) != grid.nodata) return false;
+            return true;
+        };
+        auto colEmpty = [&](size_t j) {
+            for (size_t i = top; i < bottom; ++i) if (grid.at(i, j) != grid.nodata) return false;
+            return true;
+        };
+        top = 0, bottom = grid.nrows, left = 0, right = grid.ncols;
+        while (top < bottom && rowEmpty(top)) ++top;
+        while (top < bottom && rowEmpty(bottom - 1)) --bottom;
+        while (left < right && colEmpty(left)) ++left;
+        while (left < right && colEmpty(right - 1)) --right;
+    }
+}
+
+
+AscGrid warp_tm_to_wgs84(const AscGrid& source, const TransverseMercator& tm, double resolution) {
+    size_t top, bottom, left, right;
+    trimmedWindow(source, top, bottom, left, right);
+    if (top == bottom || left == right) {
+        throw runtime_error("All data is filled with nodata_value.");
+    }
+    const size_t nrows = bottom - top, ncols = right - left;
+    const double cs = source.cellsize;
+    const double xll = source.xllcorner + left * cs;
+    const double topY = source.yllcorner + (source.nrows - top) * cs;
+    auto at = [&](size_t i, size_t j) { return source.at(top + i, left + j); };
+    auto valid = [&](float v) { return v != source.nodata && v != 0; };
+
+    // extent of the valid cell centres, each source row inverse-projected as one array
+    const size_t workers = worker_count(nrows);
+    vector<double> minLon(workers, numeric_limits<double>::max()), maxLon(workers, -numeric_limits<double>::max());
+    vector<double> minLat(workers, numeric_limits<double>::max()), maxLat(workers, -numeric_limits<double>::max());
+    parallel_for_bands(nrows, [&](size_t begin, size_t end, size_t worker) {
+        vector<double> x(ncols), y(ncols), lon(ncols), lat(ncols);
+        for (size_t j = 0; j < ncols; ++j) x[j] = xll + (j + 0.5) * cs;
+        for (size_t i = begin; i < end; ++i) {
+            fill(y.begin(), y.end(), topY - (i + 0.5) * cs);
+            tm.inverse(x.data(), y.data(), lon.data(), lat.data(), ncols);
+            for (size_t j = 0; j < ncols; ++j) {
+                if (!valid(at(i, j))) continue;
+                minLon[worker] = min(minLon[worker], lon[j]);
+                maxLon[worker] = max(maxLon[worker], lon[j]);
+                minLat[worker] = min(minLat[worker], lat[j]);
+                maxLat[worker] = max(maxLat[worker], lat[j]);
+            }
+        }
+    });
+    float west = static_cast<float>(*min_element(minLon.begin(), minLon.end()));
+    float east = static_cast<float>(*max_element(maxLon.begin(), maxLon.end()));
+    float south = static_cast<float>(*min_element(minLat.begin(), minLat.end()));
+    float north = static_cast<float>(*max_element(maxLat.begin(), maxLat.end()));
+    if (west > east) {
+        throw runtime_error("No valid cell (neither 0 nor nodata) to warp.");
+    }
+
+    AscGrid out;
+    out.ncols = max<size_t>(1, static_cast<size_t>(ceil((east - west) / resolution)));
+    out.nrows = max<size_t>(1, static_cast<size_t>(ceil((north - south) / resolution)));
+    out.xllcorner = west;
+    out.yllcorner = north - out.nrows * resolution;
+    out.cellsize = resolution;
+    out.nodata = source.nodata;
+    out.has_nodata = true;
+    out.data.resize(out.ncols * out.nrows);
+
+    const double lastRow = nrows - 1.0, lastCol = ncols - 1.0;
+    parallel_for_bands(out.nrows, [&](size_t begin, size_t end, size_t) {
+        vector<double> lon(out.ncols), lat(out.ncols), x(out.ncols), y(out.ncols);
+        for (size_t j = 0; j < out.ncols; ++j) lon[j] = west + (j + 0.5) * resolution;
+        for (size_t i = begin; i < end; ++i) {
+            fill(lat.begin(), lat.end(), north - (i + 0.5) * resolution);
+            tm.forward(lon.data(), lat.data(), x.data(), y.data(), out.ncols);
+
+            float* row = &out.data[i * out.ncols];
+            for (size_t j = 0; j < out.ncols; ++j) {
+                double r = min(max((topY - y[j]) / cs - 0.5, 0.0), lastRow);
+                double c = min(max((x[j] - xll) / cs - 0.5, 0.0), lastCol);
+                float nearest = at(static_cast<size_t>(r + 0.5), static_cast<size_t>(c + 0.5));
+                if (!valid(nearest)) {
+                    row[j] = nearest;
+                    continue;
+                }
+                size_t r0 = static_cast<size_t>(r), c0 = static_cast<size_t>(c);
+                size_t r1 = min(r0 + 1, nrows - 1), c1 = min(c0 + 1, ncols - 1);
+                double wr = r - r0, wc = c - c0;
+                const size_t rows[4] = {r0, r0, r1, r1}, cols[4] = {c0, c1, c0, c1};
+                const double weights[4] = {(1 - wr) * (1 - wc), (1 - wr) * wc, wr * (1 - wc), wr * wc};
+                double sum = 0, weight = 0;
+                for (int k = 0; k < 4; ++k) {
+                    float v = at(rows[k], cols[k]);
+                    if (!valid(v) || weights[k] == 0) continue;
+                    sum += weights[k] * v;
+                    weight += weights[k];
+                }
+                row[j] = weight > 0 ? static_cast<float>(sum / weight) : nearest;
+            }
+        }
+    });
+    return out;
+}
@@ -0,0 +1,18 @@
+#ifndef WARP_H
+#define WARP_H
+
+#include "../io/AscGrid.h"
+#include "TransverseMercator.h"
+using namespace std;
+
+// What src/warp.py resample_from_tm_to_wgs84 did with three scipy griddata passes,
+// by inverse mapping: each target EPSG:4326 cell centre is projected into the
+// regular TM grid and looked up there, one pass, rows in parallel.
+//  - the target grid spans the valid (neither 0 nor nodata) cell centres, once the
+//    all-nodata border rows and columns are trimmed as in read_asc
+//  - the nearest source cell decides nodata and 0 (ground)
+//  - otherwise bilinear over the valid cells among the four neighbours, weights
+//    renormalised, so ground and nodata are never blended into altitudes
+AscGrid warp_tm_to_wgs84(const AscGrid& source, const TransverseMercator& tm, double resolution);
+
+#endif // WARP_H
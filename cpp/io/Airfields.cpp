@@ -0,0 +1,32 @@
+#include "Airfields.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+vector<Airfield> read_airfields(const string& path) {
+    ifstream file(path);
+    if (!file.is_open()) {
+        throw runtime_error("Compute could not open airfields file " + path);
+    }
+    vector<Airfield> airfields;
+    string line;
+    getline(file, line);    // header
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        size_t first = line.find(','), second = first == string::npos ? string::npos : line.find(',', first + 1);
+        if (second == string::npos) {
+            throw runtime_error("Invalid airfield line in " + path + ": " + line);
+        }
+        Airfield airfield;
+        airfield.x = stod(line.substr(0, first));
+        airfield.y = stod(line.substr(first + 1, second - first - 1));
+        airfield.name = line.substr(second + 1);
+        airfields.push_back(airfield);
+    }
+    return airfields;
+}
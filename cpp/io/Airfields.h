@@ -0,0 +1,17 @@
+#ifndef AIRFIELDS_H
+#define AIRFIELDS_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+class Airfield {
+    public:
+        string name;
+        double x, y;    // lon, lat in degrees
+};
+
+// "x,y,name" lines after a header line; the name is the rest of the line, commas included
+vector<Airfield> read_airfields(const string& path);
+
+#endif // AIRFIELDS_H
@@ -0,0 +1,81 @@
+#include "AscGrid.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+AscGrid::AscGrid(const string& path) {
+    read(path);
+}
+
+void AscGrid::read(const string& path) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) {
+        throw runtime_error("Compute could not open grid file " + path);
+    }
+    stringstream buffer;
+    buffer << file.rdbuf();
+    string content = buffer.str();
+    const char* p = content.c_str();
+    char* end;
+
+    // header: "key value" lines until the first numeric token
+    while (true) {
+        while (*p && isspace(static_cast<unsigned char>(*p))) ++p;
+        if (!*p || !isalpha(static_cast<unsigned char>(*p))) break;
+        const char* keyStart = p;
+        while (*p && !isspace(static_cast<unsigned char>(*p))) ++p;
+        string key(keyStart, p);
+        for (auto& ch : key) ch = tolower(static_cast<unsigned char>(ch));
+        double value = strtod(p, &end);
+        if (end == p) throw runtime_error("Invalid header line " + key + " in " + path);
+        p = end;
+
+        if (key == "ncols") ncols = static_cast<size_t>(value);
+        else if (key == "nrows") nrows = static_cast<size_t>(value);
+        else if (key == "xllcorner" || key == "xllcenter") xllcorner = value;
+        else if (key == "yllcorner" || key == "yllcenter") yllcorner = value;
+        else if (key == "cellsize") cellsize = value;
+        else if (key == "nodata_value") { nodata = static_cast<float>(value); has_nodata = true; }
+    }
+    if (ncols == 0 || nrows == 0 || cellsize <= 0) {
+        throw runtime_error("Incomplete header in " + path);
+    }
+
+    data.resize(ncols * nrows);
+    for (size_t k = 0; k < data.size(); ++k) {
+        data[k] = strtof(p, &end);
+        if (end == p) {
+            throw runtime_error("Failed to read value " + to_string(k) + " of " + path);
+        }
+        p = end;
+    }
+}
+
+void AscGrid::write(const string& path, int decimals) const {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        throw runtime_error("Unable to open file " + path + " for writing.");
+    }
+    fprintf(f, "ncols %lu\nnrows %lu\nxllcorner %.10g\nyllcorner %.10g\ncellsize %.10g\n",
+            static_cast<unsigned long>(ncols), static_cast<unsigned long>(nrows), xllcorner, yllcorner, cellsize);
+    if (has_nodata) fprintf(f, "NODATA_value %g\n", nodata);
+
+    for (size_t i = 0; i < nrows; ++i) {
+        for (size_t j = 0; j < ncols; ++j) {
+            if (j > 0) fputc(' ', f);
+            if (decimals < 0) fprintf(f, "%g", data[i * ncols + j]);
+            else fprintf(f, "%.*f", decimals, data[i * ncols + j]);
+        }
+        fputc('\n', f);
+    }
+    fclose(f);
+}
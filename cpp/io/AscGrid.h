@@ -0,0 +1,32 @@
+#ifndef ASCGRID_H
+#define ASCGRID_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+using namespace std;
+
+// A whole Arc/Info ASCII grid in memory, row-major with row 0 = north.
+// The NODATA_value line is optional, as in the topography files.
+class AscGrid {
+    public:
+        size_t ncols = 0, nrows = 0;
+        double xllcorner = 0, yllcorner = 0, cellsize = 0;
+        float nodata = -9999;
+        bool has_nodata = false;
+        vector<float> data;
+
+        AscGrid() {}
+
+        AscGrid(const string& path);
+
+        void read(const string& path);
+
+        void write(const string& path, int decimals = -1) const;
+
+        inline float at(size_t i, size_t j) const { return data[i * ncols + j]; }
+
+        inline bool isNodata(float v) const { return has_nodata && v == nodata; }
+};
+
+#endif // ASCGRID_H
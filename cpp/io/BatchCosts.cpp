@@ -0,0 +1,155 @@
+#include "BatchCosts.h"
+#include "../geo/LocalDem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+using namespace std;
+
+namespace {
+    const size_t SAMPLES = 32;     // per side of the TM square
+    const double PI = 3.14159265358979323846;
+
+    // "cells open seconds key" lines into entries; malformed lines are skipped
+    void readEntries(const string& path, map<string, pair<AirfieldCost, double>>& entries) {
+        if (path.empty()) return;
+        ifstream in(path);
+        string line;
+        while (getline(in, line)) {
+            istringstream fields(line);
+            AirfieldCost cost;
+            double seconds;
+            string key;
+            if (!(fields >> cost.cells >> cost.open >> seconds)) continue;
+            getline(fields >> ws, key);
+            if (key.empty() || seconds < 0) continue;
+            entries[key] = make_pair(cost, seconds);
+        }
+    }
+}
+
+
+AirfieldCost estimate_airfield_cost(const AscGrid* dem, const TransverseMercator& tm, const Params& params,
+                                    float elevation, float radius, float cellsize) {
+    AirfieldCost cost;
+    double side = 2.0 * radius / cellsize;
+    cost.cells = side * side;
+    if (!dem) {
+        cost.open = cost.cells * PI / 4;
+        return cost;
+    }
+
+    // a sample is open when its terrain plus the ground clearance is below the cone
+    // starting from the circuit altitude at home, within the reach of the cone
+    const double step = 2.0 * radius / SAMPLES;
+    const double circuit = elevation + params.securite;
+    vector<double> x(SAMPLES), y(SAMPLES), lon(SAMPLES), lat(SAMPLES);
+    for (size_t j = 0; j < SAMPLES; ++j) x[j] = -radius + (j + 0.5) * step;
+    size_t open = 0;
+    for (size_t i = 0; i < SAMPLES; ++i) {
+        fill(y.begin(), y.end(), radius - (i + 0.5) * step);
+        tm.inverse(x.data(), y.data(), lon.data(), lat.data(), SAMPLES);
+        for (size_t j = 0; j < SAMPLES; ++j) {
+            double distance = sqrt(x[j] * x[j] + y[j] * y[j]);
+            if (distance > radius) continue;
+            float terrain = dem_value_at(*dem, lon[j], lat[j]);
+            if (terrain == dem->nodata) terrain = 0;
+            if (terrain + params.distSol < circuit + distance / params.finesse) ++open;
+        }
+    }
+    cost.open = cost.cells * open / (SAMPLES * SAMPLES);
+    return cost;
+}
+
+
+CostHistory::CostHistory(const string& path) : path(path) {
+    map<string, pair<AirfieldCost, double>> read;
+    readEntries(path, read);
+    for (const auto& entry : read) {
+        entries[entry.first] = Entry{entry.second.first, entry.second.second};
+    }
+    fit();
+}
+
+// least squares of seconds = a * cells + b * open; a single scale of the default weights
+// when that is degenerate or gives a negative weight (few airfields, all alike)
+void CostHistory::fit() {
+    double cc = 0, co = 0, oo = 0, cs = 0, os = 0;
+    for (const auto& entry : entries) {
+        const AirfieldCost& cost = entry.second.cost;
+        cc += cost.cells * cost.cells;
+        co += cost.cells * cost.open;
+        oo += cost.open * cost.open;
+        cs += cost.cells * entry.second.seconds;
+        os += cost.open * entry.second.seconds;
+    }
+    double det = cc * oo - co * co;
+    if (entries.size() >= 3 && det > 1e-9 * cc * oo) {
+        double fa = (cs * oo - os * co) / det, fb = (os * cc - cs * co) / det;
+        if (fa >= 0 && fb >= 0 && fa + fb > 0) {
+            a = fa, b = fb;
+            return;
+        }
+    }
+    double predicted = 0, seconds = 0;
+    for (const auto& entry : entries) {
+        predicted += a * entry.second.cost.cells + b * entry.second.cost.open;
+        seconds += entry.second.seconds;
+    }
+    if (predicted > 0 && seconds > 0) {
+        a *= seconds / predicted;
+        b *= seconds / predicted;
+    }
+}
+
+double CostHistory::predict(const string& key, const AirfieldCost& cost) const {
+    auto known = entries.find(key);
+    if (known != entries.end()) return known->second.seconds;
+    return a * cost.cells + b * cost.open;
+}
+
+void CostHistory::record(const string& key, const AirfieldCost& cost, double seconds) {
+    lock_guard<mutex> guard(lock);
+    measured[key] = Entry{cost, seconds};
+}
+
+void CostHistory::save() {
+    lock_guard<mutex> guard(lock);
+    if (path.empty() || measured.empty()) return;
+    // other processes may have added airfields since this one read the file
+    map<string, pair<AirfieldCost, double>> merged;
+    readEntries(path, merged);
+    for (const auto& entry : measured) {
+        merged[entry.first] = make_pair(entry.second.cost, entry.second.seconds);
+    }
+
+    string temporary = path + "." + to_string(chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        ofstream out(temporary);
+        out.precision(9);
+        for (const auto& entry : merged) {
+            out << entry.second.first.cells << " " << entry.second.first.open << " "
+                << entry.second.second << " " << entry.first << "\n";
+        }
+        if (!out) throw runtime_error("Unable to write " + temporary);
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(path.c_str());       // Windows does not replace existing files
+        if (rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(temporary.c_str());
+            throw runtime_error("Unable to write " + path);
+        }
+    }
+}
+
+
+vector<size_t> longest_first(const vector<double>& costs) {
+    vector<size_t> order(costs.size());
+    for (size_t k = 0; k < order.size(); ++k) order[k] = k;
+    stable_sort(order.begin(), order.end(), [&](size_t p, size_t q) { return costs[p] > costs[q]; });
+    return order;
+}
@@ -0,0 +1,67 @@
+#ifndef BATCHCOSTS_H
+#define BATCHCOSTS_H
+
+#include "AscGrid.h"
+#include "Params.h"
+#include "../geo/TransverseMercator.h"
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Work of one compute batch airfield, known before running it: the cells of its TM
+// square (extraction, outputs) and, from a coarse sample of the topography, how many of
+// them lie under the glide cone of the home, which is roughly what the propagation visits.
+class AirfieldCost {
+    public:
+        double cells = 0;
+        double open = 0;
+};
+
+// Samples the TM square of half-width `radius` on a 32x32 lattice. Without a DEM (.hgt
+// tile folders, not read before the airfield runs) every cell of the disk counts as open.
+AirfieldCost estimate_airfield_cost(const AscGrid* dem, const TransverseMercator& tm, const Params& params,
+                                    float elevation, float radius, float cellsize);
+
+// Measured seconds of the airfields computed by previous batch runs, one
+// "cells open seconds key" line each, the key (airfield, position and everything the run
+// time depends on) being the rest of the line. predict() returns the measured time of an
+// airfield run before with the same key, otherwise a*cells + b*open with a and b fitted
+// by least squares over the file. Without history the default weights only rank the
+// airfields. record() may be called from several threads; save() merges the new
+// measurements into the file, replacing it through a rename. An empty path reads and
+// writes nothing.
+class CostHistory {
+    public:
+        CostHistory(const string& path);
+
+        double predict(const string& key, const AirfieldCost& cost) const;
+
+        void record(const string& key, const AirfieldCost& cost, double seconds);
+
+        void save();
+
+        size_t size() const { return entries.size(); }
+
+    private:
+        class Entry {
+            public:
+                AirfieldCost cost;
+                double seconds;
+        };
+
+        string path;
+        map<string, Entry> entries, measured;
+        double a = 0.25, b = 1;     // default: an open cell costs about four plain ones
+        mutex lock;
+
+        void fit();
+};
+
+// indices of costs from the largest to the smallest, ties in their original order: handed
+// out one at a time to the next free worker, this is longest-processing-time-first
+vector<size_t> longest_first(const vector<double>& costs);
+
+#endif // BATCHCOSTS_H
@@ -0,0 +1,85 @@
+#include "ContourWriter.h"
+
+#include "../geo/Contours.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+void write_contours_geojson(const vector<ContourLine>& lines, const string& destinationFile) {
+    ofstream outputFile(destinationFile);
+
+    if (outputFile.is_open()) {
+        outputFile << "{\"type\": \"FeatureCollection\", \"features\": [";
+        char buffer[64];
+        for (size_t l = 0; l < lines.size(); ++l) {
+            const ContourLine& line = lines[l];
+            if (l > 0) outputFile << ", ";
+            outputFile << "{\"type\": \"Feature\", \"geometry\": {\"type\": \"LineString\", \"coordinates\": [";
+            for (size_t k = 0; k < line.x.size(); ++k) {
+                // 7 decimals is ~1 cm, well below the DEM resolution
+                snprintf(buffer, sizeof(buffer), "%s[%.7f, %.7f]", k > 0 ? ", " : "", line.x[k], line.y[k]);
+                outputFile << buffer;
+            }
+            outputFile << "]}, \"properties\": {\"ELEV\": \"" << static_cast<int>(line.level) << "\"}}";
+        }
+        outputFile << "]}";
+        outputFile.close();
+    } else {
+        cerr << "Unable to open file " << destinationFile << " for writing." << endl;
+    }
+}
+
+void write_contours_topojson(const vector<ContourLine>& lines, const string& destinationFile, double quantum) {
+    ofstream outputFile(destinationFile);
+
+    if (outputFile.is_open()) {
+        double minx = 180, miny = 90;
+        for (const ContourLine& line : lines) {
+            for (size_t k = 0; k < line.x.size(); ++k) {
+                minx = min(minx, line.x[k]);
+                miny = min(miny, line.y[k]);
+            }
+        }
+
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "{\"type\":\"Topology\",\"transform\":{\"scale\":[%.10g,%.10g],\"translate\":[%.10f,%.10f]},",
+                 quantum, quantum, minx, miny);
+        outputFile << buffer << "\"objects\":{\"contours\":{\"type\":\"GeometryCollection\",\"geometries\":[";
+        for (size_t l = 0; l < lines.size(); ++l) {
+            if (l > 0) outputFile << ",";
+            outputFile << "{\"type\":\"LineString\",\"arcs\":[" << l << "],\"properties\":{\"ELEV\":\""
+                       << static_cast<int>(lines[l].level) << "\"}}";
+        }
+        outputFile << "]}},\"arcs\":[";
+        for (size_t l = 0; l < lines.size(); ++l) {
+            const ContourLine& line = lines[l];
+            if (l > 0) outputFile << ",";
+            outputFile << "[";
+            long long px = 0, py = 0;
+            size_t written = 0;
+            for (size_t k = 0; k < line.x.size(); ++k) {
+                long long qx = llround((line.x[k] - minx) / quantum);
+                long long qy = llround((line.y[k] - miny) / quantum);
+                if (written > 0 && qx == px && qy == py) continue;
+                snprintf(buffer, sizeof(buffer), "%s[%lld,%lld]", written > 0 ? "," : "", qx - px, qy - py);
+                outputFile << buffer;
+                px = qx;
+                py = qy;
+                ++written;
+            }
+            // an arc needs at least two positions
+            if (written == 1) outputFile << ",[0,0]";
+            outputFile << "]";
+        }
+        outputFile << "]}";
+        outputFile.close();
+    } else {
+        cerr << "Unable to open file " << destinationFile << " for writing." << endl;
+    }
+}
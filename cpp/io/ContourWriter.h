@@ -0,0 +1,18 @@
+#ifndef CONTOURWRITER_H
+#define CONTOURWRITER_H
+
+#include "../geo/Contours.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+// Writes lines whose x/y already hold lon/lat as a GeoJSON FeatureCollection of
+// LineStrings with an "ELEV" property, the layout generate_contours_from_asc produces.
+void write_contours_geojson(const vector<ContourLine>& lines, const string& destinationFile);
+
+// Same features as a TopoJSON topology: one arc per line, coordinates quantised to
+// integers on a grid of `quantum` degrees and delta-encoded, as in the TopoJSON spec.
+// Repeated points after quantisation are dropped.
+void write_contours_topojson(const vector<ContourLine>& lines, const string& destinationFile, double quantum);
+
+#endif // CONTOURWRITER_H
@@ -0,0 +1,231 @@
+#include "Deflate.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+    const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    const size_t WINDOW = 32768;
+    const int HASH_BITS = 15;
+
+    class BitWriter {
+        public:
+            vector<uint8_t>& out;
+            uint32_t buffer = 0;
+            int count = 0;
+
+            BitWriter(vector<uint8_t>& o) : out(o) {}
+
+            // LSB first, as deflate wants for everything but Huffman codes
+            void bits(uint32_t value, int n) {
+                buffer |= value << count;
+                count += n;
+                while (count >= 8) {
+                    out.push_back(static_cast<uint8_t>(buffer));
+                    buffer >>= 8;
+                    count -= 8;
+                }
+            }
+
+            // Huffman codes go MSB first
+            void code(uint32_t value, int n) {
+                uint32_t reversed = 0;
+                for (int k = 0; k < n; ++k) reversed |= ((value >> k) & 1u) << (n - 1 - k);
+                bits(reversed, n);
+            }
+
+            void flush() {
+                if (count > 0) out.push_back(static_cast<uint8_t>(buffer));
+                buffer = 0;
+                count = 0;
+            }
+    };
+
+    void literal(BitWriter& w, unsigned symbol) {
+        if (symbol < 144) w.code(0x30 + symbol, 8);
+        else if (symbol < 256) w.code(0x190 + symbol - 144, 9);
+        else if (symbol < 280) w.code(symbol - 256, 7);
+        else w.code(0xC0 + symbol - 280, 8);
+    }
+
+    void match(BitWriter& w, size_t length, size_t distance) {
+        int l = 28;
+        while (LENGTH_BASE[l] > length) --l;
+        literal(w, 257 + l);
+        w.bits(static_cast<uint32_t>(length - LENGTH_BASE[l]), LENGTH_EXTRA[l]);
+        int d = 29;
+        while (DIST_BASE[d] > distance) --d;
+        w.code(d, 5);
+        w.bits(static_cast<uint32_t>(distance - DIST_BASE[d]), DIST_EXTRA[d]);
+    }
+
+    class BitReader {
+        public:
+            const vector<uint8_t>& in;
+            size_t position;
+            uint64_t buffer = 0;
+            int count = 0;
+
+            BitReader(const vector<uint8_t>& i, size_t start) : in(i), position(start) {}
+
+            uint32_t bits(int n) {
+                while (count < n) {
+                    if (position >= in.size()) throw runtime_error("Truncated deflate stream.");
+                    buffer |= static_cast<uint64_t>(in[position++]) << count;
+                    count += 8;
+                }
+                uint32_t value = static_cast<uint32_t>(buffer & ((1ull << n) - 1));
+                buffer >>= n;
+                count -= n;
+                return value;
+            }
+
+            // Huffman codes come MSB first
+            uint32_t code(int n) {
+                uint32_t value = 0;
+                for (int k = 0; k < n; ++k) value = (value << 1) | bits(1);
+                return value;
+            }
+
+            void alignToByte() {
+                buffer >>= count % 8;
+                count -= count % 8;
+            }
+    };
+
+    // symbol of the fixed literal/length code
+    unsigned fixedLiteral(BitReader& r) {
+        uint32_t c = r.code(7);
+        if (c <= 0x17) return 256 + c;
+        c = (c << 1) | r.bits(1);
+        if (c >= 0x30 && c <= 0xBF) return c - 0x30;
+        if (c >= 0xC0 && c <= 0xC7) return 280 + c - 0xC0;
+        c = (c << 1) | r.bits(1);
+        return 144 + c - 0x190;
+    }
+}
+
+
+// zlib stream of one fixed-Huffman deflate block
+vector<uint8_t> zlib_compress(const vector<uint8_t>& data, int maxChain) {
+    vector<uint8_t> out;
+    out.push_back(0x78);
+    out.push_back(0x01);
+    BitWriter w(out);
+    w.bits(1, 1);    // final block
+    w.bits(1, 2);    // fixed Huffman codes
+
+    const size_t n = data.size();
+    vector<int32_t> head(1u << HASH_BITS, -1);
+    vector<int32_t> prev(WINDOW, -1);     // chains never go further back than the window
+    auto hash = [&](size_t p) {
+        uint32_t v = data[p] | (data[p + 1] << 8) | (data[p + 2] << 16);
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    };
+    auto insert = [&](size_t p) {
+        if (p + 2 >= n) return;
+        uint32_t h = hash(p);
+        prev[p & (WINDOW - 1)] = head[h];
+        head[h] = static_cast<int32_t>(p);
+    };
+
+    size_t p = 0;
+    while (p < n) {
+        size_t bestLength = 0, bestDistance = 0;
+        if (p + 2 < n) {
+            size_t limit = min<size_t>(258, n - p);
+            int chain = maxChain;
+            for (int32_t q = head[hash(p)]; q >= 0 && p - q <= WINDOW && chain-- > 0; q = prev[q & (WINDOW - 1)]) {
+                size_t length = 0;
+                while (length < limit && data[q + length] == data[p + length]) ++length;
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = p - q;
+                    if (length == limit) break;
+                }
+            }
+        }
+        if (bestLength >= 3) {
+            match(w, bestLength, bestDistance);
+            for (size_t k = 0; k < bestLength; ++k) insert(p + k);
+            p += bestLength;
+        } else {
+            literal(w, data[p]);
+            insert(p);
+            ++p;
+        }
+    }
+    literal(w, 256);
+    w.flush();
+
+    uint32_t a = 1, b = 0;
+    for (uint8_t v : data) {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(adler >> shift));
+    return out;
+}
+
+// Stored and fixed-Huffman blocks, which is all zlib_compress writes
+vector<uint8_t> zlib_decompress(const vector<uint8_t>& stream) {
+    if (stream.size() < 6 || (stream[0] & 0x0F) != 8 || ((stream[0] << 8) | stream[1]) % 31 != 0) {
+        throw runtime_error("Not a zlib stream.");
+    }
+    vector<uint8_t> out;
+    BitReader r(stream, 2);
+    bool last = false;
+    while (!last) {
+        last = r.bits(1) == 1;
+        uint32_t type = r.bits(2);
+        if (type == 0) {
+            r.alignToByte();
+            uint32_t length = r.bits(16);
+            if ((r.bits(16) ^ 0xFFFF) != length) throw runtime_error("Corrupt stored deflate block.");
+            for (uint32_t k = 0; k < length; ++k) out.push_back(static_cast<uint8_t>(r.bits(8)));
+        } else if (type == 1) {
+            for (;;) {
+                unsigned symbol = fixedLiteral(r);
+                if (symbol < 256) {
+                    out.push_back(static_cast<uint8_t>(symbol));
+                    continue;
+                }
+                if (symbol == 256) break;
+                unsigned l = symbol - 257;
+                if (l >= 29) throw runtime_error("Corrupt deflate length code.");
+                size_t length = LENGTH_BASE[l] + r.bits(LENGTH_EXTRA[l]);
+                unsigned d = r.code(5);
+                if (d >= 30) throw runtime_error("Corrupt deflate distance code.");
+                size_t distance = DIST_BASE[d] + r.bits(DIST_EXTRA[d]);
+                if (distance > out.size()) throw runtime_error("Corrupt deflate distance.");
+                size_t from = out.size() - distance;
+                for (size_t k = 0; k < length; ++k) out.push_back(out[from + k]);
+            }
+        } else {
+            throw runtime_error("Unsupported deflate block type " + to_string(type) + ".");
+        }
+    }
+
+    r.alignToByte();
+    uint32_t expected = 0;
+    for (int k = 0; k < 4; ++k) expected = (expected << 8) | r.bits(8);
+    uint32_t a = 1, b = 0;
+    for (uint8_t v : out) {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    if (((b << 16) | a) != expected) throw runtime_error("zlib checksum mismatch.");
+    return out;
+}
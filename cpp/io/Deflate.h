@@ -0,0 +1,16 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// Self-contained zlib streams so that compute needs no zlib: one fixed-Huffman deflate
+// block, LZ77 over a 32 KiB window with hash chains of at most maxChain candidates.
+vector<uint8_t> zlib_compress(const vector<uint8_t>& data, int maxChain = 32);
+
+// Inverse of zlib_compress; stored and fixed-Huffman blocks only, throws on anything else
+// or on a checksum mismatch.
+vector<uint8_t> zlib_decompress(const vector<uint8_t>& stream);
+
+#endif // DEFLATE_H
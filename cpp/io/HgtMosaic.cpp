@@ -0,0 +1,268 @@
+#include "HgtMosaic.h"
+
+#include "../data/Parallel.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+using namespace std;
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HGT_AVX2 1
+#include <immintrin.h>
+#endif
+
+// One read-only mapping, closed with the mosaic
+class HgtMosaic::MappedTile {
+    public:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        bool open(const string& path) {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER length;
+            GetFileSizeEx(file, &length);
+            size = static_cast<size_t>(length.QuadPart);
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) throw runtime_error("Unable to map " + path);
+            data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat info;
+            fstat(fd, &info);
+            size = static_cast<size_t>(info.st_size);
+            void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (view == MAP_FAILED) throw runtime_error("Unable to map " + path);
+            data = static_cast<const uint8_t*>(view);
+#endif
+            if (!data) throw runtime_error("Unable to map " + path);
+            return true;
+        }
+
+        ~MappedTile() {
+#ifdef _WIN32
+            if (data) UnmapViewOfFile(data);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+            if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+};
+
+namespace {
+    // "N45E006", as hgt_reader.generate_coordinate_string for the tile's south-west corner
+    string tileName(int lat, int lon) {
+        char name[32];
+        snprintf(name, sizeof(name), "%c%02d%c%03d", lat >= 0 ? 'N' : 'S', abs(lat), lon >= 0 ? 'E' : 'W', abs(lon));
+        return name;
+    }
+
+    float sampleValue(const uint8_t* p) {
+        int16_t v = static_cast<int16_t>((p[0] << 8) | p[1]);
+        return v;
+    }
+
+#ifdef HGT_AVX2
+    // 16 big-endian samples at a time; returns where it stopped, the scalar loop does the rest
+    __attribute__((target("avx2")))
+    size_t convertAvx2(const uint8_t* in, size_t n, float* out) {
+        const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                              1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        size_t k = 0;
+        for (; k + 16 <= n; k += 16) {
+            __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * k)), swap);
+            __m256i low = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+            __m256i high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+            _mm256_storeu_ps(out + k, _mm256_cvtepi32_ps(low));
+            _mm256_storeu_ps(out + k + 8, _mm256_cvtepi32_ps(high));
+        }
+        return k;
+    }
+
+    bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+    // n big-endian int16 samples to floats
+    void convert(const uint8_t* in, size_t n, float* out) {
+        size_t k = 0;
+#ifdef HGT_AVX2
+        if (hasAvx2()) k = convertAvx2(in, n, out);
+#endif
+        for (; k < n; ++k) out[k] = sampleValue(in + 2 * k);
+    }
+}
+
+
+bool is_directory(const string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFDIR;
+}
+
+void make_directory(const string& path) {
+    if (is_directory(path)) return;
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+    if (!is_directory(path)) {
+        throw runtime_error("Unable to create the folder " + path);
+    }
+}
+
+HgtMosaic::HgtMosaic(const string& folder) : folder(folder) {
+    if (!is_directory(folder)) {
+        throw runtime_error("No .hgt folder " + folder);
+    }
+}
+
+HgtMosaic::~HgtMosaic() {}
+
+const HgtMosaic::MappedTile* HgtMosaic::tile(int lat, int lon) const {
+    lock_guard<mutex> guard(lock);
+    auto found = tiles.find(make_pair(lat, lon));
+    if (found != tiles.end()) return found->second.get();
+
+    string name = tileName(lat, lon);
+    unique_ptr<MappedTile> mapped(new MappedTile());
+    bool opened = mapped->open(folder + "/" + name + ".hgt");
+    if (!opened) {
+        for (auto& ch : name) ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        opened = mapped->open(folder + "/" + name + ".hgt");
+    }
+    if (opened) {
+        size_t side = static_cast<size_t>(sqrt(mapped->size / 2.0) + 0.5);
+        if ((side != 1201 && side != 3601) || side * side * 2 != mapped->size) {
+            throw runtime_error("Invalid HGT file size for " + name + ": " + to_string(mapped->size) + " bytes");
+        }
+        if (samples != 0 && samples != side) {
+            throw runtime_error("HGT tiles of different resolutions in " + folder);
+        }
+        samples = side;
+    } else {
+        mapped.reset();
+    }
+    const MappedTile* result = mapped.get();
+    tiles[make_pair(lat, lon)] = move(mapped);
+    return result;
+}
+
+AscGrid HgtMosaic::window(double west, double south, double east, double north) const {
+    // open every tile touched first, which also tells the resolution
+    const int lat0 = static_cast<int>(floor(south)), lat1 = static_cast<int>(floor(north));
+    const int lon0 = static_cast<int>(floor(west)), lon1 = static_cast<int>(floor(east));
+    const size_t tileRows = lat1 - lat0 + 2, tileCols = lon1 - lon0 + 2;   // one more on each side for shared borders
+    vector<const MappedTile*> touched(tileRows * tileCols);
+    bool any = false;
+    for (size_t a = 0; a < tileRows; ++a) {
+        for (size_t b = 0; b < tileCols; ++b) {
+            touched[a * tileCols + b] = tile(lat0 - 1 + a, lon0 - 1 + b);
+            any = any || touched[a * tileCols + b];
+        }
+    }
+    // on these tiles only, whatever other windows opened before
+    if (!any) {
+        throw runtime_error("No .hgt tile of " + folder + " covers the area around " + tileName(lat0, lon0));
+    }
+    size_t side;
+    {
+        lock_guard<mutex> guard(lock);
+        side = samples;
+    }
+    const long step = static_cast<long>(side) - 1;     // samples per degree
+    auto tileAt = [&](long tileLat, long tileLon) -> const MappedTile* {
+        long a = tileLat - (lat0 - 1), b = tileLon - (lon0 - 1);
+        if (a < 0 || b < 0 || a >= static_cast<long>(tileRows) || b >= static_cast<long>(tileCols)) return nullptr;
+        return touched[a * tileCols + b];
+    };
+    auto floorDiv = [](long v, long d) { return v >= 0 ? v / d : -((-v + d - 1) / d); };
+
+    // global sample indices: longitude J / step, latitude I / step
+    const long J0 = static_cast<long>(floor(west * step)), J1 = static_cast<long>(ceil(east * step));
+    const long I0 = static_cast<long>(floor(south * step)), I1 = static_cast<long>(ceil(north * step));
+    AscGrid out;
+    out.ncols = J1 - J0 + 1;
+    out.nrows = I1 - I0 + 1;
+    out.cellsize = 1.0 / step;
+    out.xllcorner = (J0 - 0.5) / step;
+    out.yllcorner = (I0 - 0.5) / step;
+    out.nodata = VOID_VALUE;
+    out.has_nodata = true;
+    out.data.resize(out.ncols * out.nrows);
+
+    // mean of the non-void values of every tile holding sample (I, J)
+    auto shared = [&](long I, long J) -> float {
+        double sum = 0;
+        int count = 0;
+        for (long tileLat = floorDiv(I - 1, step); tileLat * step <= I; ++tileLat) {
+            for (long tileLon = floorDiv(J - 1, step); tileLon * step <= J; ++tileLon) {
+                if (I > (tileLat + 1) * step || J > (tileLon + 1) * step) continue;
+                const MappedTile* t = tileAt(tileLat, tileLon);
+                if (!t) continue;
+                size_t r = (tileLat + 1) * step - I, c = J - tileLon * step;
+                float v = sampleValue(t->data + 2 * (r * side + c));
+                if (v == VOID_VALUE) continue;
+                sum += v;
+                ++count;
+            }
+        }
+        return count > 0 ? static_cast<float>(sum / count) : static_cast<float>(VOID_VALUE);
+    };
+
+    parallel_for_bands(out.nrows, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            const long I = I1 - static_cast<long>(i);
+            float* row = &out.data[i * out.ncols];
+            if (I % step == 0) {
+                for (size_t j = 0; j < out.ncols; ++j) row[j] = shared(I, J0 + static_cast<long>(j));
+                continue;
+            }
+            // rows inside a tile row: contiguous runs per tile, shared columns averaged
+            const long tileLat = floorDiv(I, step);
+            const size_t r = (tileLat + 1) * step - I;
+            long J = J0;
+            while (J <= J1) {
+                if (J % step == 0) {
+                    row[J - J0] = shared(I, J);
+                    ++J;
+                    continue;
+                }
+                const long tileLon = floorDiv(J, step);
+                const long runEnd = min(J1 + 1, (tileLon + 1) * step);
+                const MappedTile* t = tileAt(tileLat, tileLon);
+                float* target = row + (J - J0);
+                if (t) convert(t->data + 2 * (r * side + (J - tileLon * step)), runEnd - J, target);
+                else fill(target, target + (runEnd - J), static_cast<float>(VOID_VALUE));
+                J = runEnd;
+            }
+        }
+    });
+    return out;
+}
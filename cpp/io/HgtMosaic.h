@@ -0,0 +1,51 @@
+#ifndef HGTMOSAIC_H
+#define HGTMOSAIC_H
+
+#include "AscGrid.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+using namespace std;
+
+// A folder of SRTM .hgt tiles (N45E006.hgt or n45e006.hgt, 1201x1201 or 3601x3601
+// big-endian int16, as cached by hgt_reader.py) used as an EPSG:4326 topography
+// without merging them: each tile is memory-mapped when first needed and only the
+// requested window is converted to floats.
+// Samples sit on whole multiples of the tile step, so the grids returned have
+// xllcorner/yllcorner half a step before the first sample. Border samples shared by
+// neighbouring tiles are averaged over the tiles that have them, voids excluded.
+// window() may be called from several threads.
+class HgtMosaic {
+    public:
+        static const int16_t VOID_VALUE = -32768;
+
+        HgtMosaic(const string& folder);
+
+        ~HgtMosaic();
+
+        // every sample within the bounds (degrees); missing tiles and voids are nodata.
+        // Throws when none of the tiles around the bounds exists.
+        AscGrid window(double west, double south, double east, double north) const;
+
+    private:
+        class MappedTile;
+
+        string folder;
+        mutable mutex lock;
+        mutable map<pair<int, int>, unique_ptr<MappedTile>> tiles;     // (lat, lon) of the south-west corner
+        mutable size_t samples = 0;                                     // per tile side, once a tile was opened
+
+        const MappedTile* tile(int lat, int lon) const;
+};
+
+// true when path is a folder, for inputs that may be an .asc file or a tile folder
+bool is_directory(const string& path);
+
+// creates the folder (not its parents) unless it exists, throws when it cannot
+void make_directory(const string& path);
+
+#endif // HGTMOSAIC_H
@@ -3,14 +3,25 @@
 #include <algorithm>
 #include <cstddef>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 using namespace std;
 
+namespace {
+    // true, false, 1 or 0 in any case, as exportPasses
+    bool parseFlag(const string& option, string value) {
+        transform(value.begin(), value.end(), value.begin(), [](unsigned char c){ return tolower(c); });
+        if (value == "true" || value == "1") return true;
+        if (value == "false" || value == "0") return false;
+        throw runtime_error("Invalid value for " + option + ". Expected 'true', 'false', '0', or '1'.");
+    }
+}
+
 
 Params::Params(int argc, char* argv[]) {
     if (argc < 10) {
-        throw runtime_error("Not enough arguments provided. Expected format: ./compute homex homey finesse distSol securite nodataltitude output_path topology");
+        throw runtime_error("Not enough arguments provided. Expected format: ./compute homex homey finesse distSol securite nodataltitude output_path topology exportPasses [--option value ...]");
     }
     // Convert arguments to appropriate types
     homex = stof(argv[1]);
@@ -32,4 +43,211 @@ Params::Params(int argc, char* argv[]) {
         std::cout << "Received value for exportPasses: " << exportPasses << std::endl;
         throw std::runtime_error("Invalid value for exportPasses. Expected 'true', 'false', '0', or '1'.");
     }
-}
\ No newline at end of file
+
+    parseOptions(argc, argv, 10);
+}
+
+void Params::parseOptions(int argc, char* argv[], int first) {
+    for (int i = first; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            throw runtime_error("Missing value for option " + option);
+        }
+        setOption(option, argv[i + 1]);
+    }
+}
+
+void Params::setOption(const string& option, const string& value) {
+    if (option == "--crs") {
+        crs_file = value;
+    } else if (option == "--contours") {
+        contours_file = value;
+    } else if (option == "--contour-height") {
+        contour_height = stof(value);
+        if (contour_height <= 0) throw runtime_error("--contour-height must be positive.");
+    } else if (option == "--simplify") {
+        simplify = stof(value);
+    } else if (option == "--contour-format") {
+        contour_format = value;
+        if (contour_format != "geojson" && contour_format != "topojson") {
+            throw runtime_error("Invalid value for --contour-format. Expected 'geojson' or 'topojson'.");
+        }
+    } else if (option == "--fixed-point") {
+        fixed_point = parseFlag(option, value);
+    } else if (option == "--neighbours") {
+        int count = stoi(value);
+        if (count != 4 && count != 8) throw runtime_error("--neighbours must be 4 or 8.");
+        neighbours = count;
+    } else if (option == "--checkpoint") {
+        checkpoint_file = value;
+    } else if (option == "--checkpoint-every") {
+        checkpoint_every = stod(value);
+        if (checkpoint_every <= 0) throw runtime_error("--checkpoint-every must be positive.");
+    } else if (option == "--resume") {
+        resume = parseFlag(option, value);
+    } else if (option == "--preview") {
+        preview_file = value;
+    } else if (option == "--preview-levels") {
+        // comma separated block sizes, solved from the coarsest; "none" for the full frame only
+        preview_levels.clear();
+        stringstream list(value == "none" ? string() : value);
+        string level;
+        while (getline(list, level, ',')) {
+            int factor = stoi(level);
+            if (factor < 2) throw runtime_error("--preview-levels must be block sizes of 2 or more.");
+            preview_levels.push_back(static_cast<size_t>(factor));
+        }
+        sort(preview_levels.rbegin(), preview_levels.rend());
+        preview_levels.erase(unique(preview_levels.begin(), preview_levels.end()), preview_levels.end());
+    } else {
+        throw runtime_error("Unknown option " + option);
+    }
+}
+
+BatchParams::BatchParams(int argc, char* argv[]) {
+    if (argc < 10) {
+        throw runtime_error("Not enough arguments provided. Expected format: ./compute batch topography4326.asc airfields.csv finesse distSol securite nodataltitude calculation_folder exportPasses [--cellsize 100] [--contours {name}.geojson] [--cache folder] [--cache-size 2048] [--threads 0] [--costs costs.txt] [--shard k/n] [--only names.txt] [--option value ...]");
+    }
+    topography = argv[2];
+    airfields_file = argv[3];
+    base.finesse = stoi(argv[4]);
+    base.distSol = stoi(argv[5]);
+    base.securite = stoi(argv[6]);
+    base.nodataltitude = stoi(argv[7]);
+    calculation_folder = argv[8];
+    base.exportPasses = argv[9];
+    base.homex = base.homey = 0;
+    std::transform(base.exportPasses.begin(), base.exportPasses.end(), base.exportPasses.begin(),
+                [](unsigned char c){ return std::tolower(c); });
+    if (base.exportPasses != "true" && base.exportPasses != "false" &&
+        base.exportPasses != "0" && base.exportPasses != "1") {
+        throw runtime_error("Invalid value for exportPasses. Expected 'true', 'false', '0', or '1'.");
+    }
+
+    for (int i = 10; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            throw runtime_error("Missing value for option " + option);
+        }
+        string value = argv[i + 1];
+
+        if (option == "--cellsize") {
+            cellsize = stof(value);
+            if (cellsize <= 0) throw runtime_error("--cellsize must be positive.");
+        } else if (option == "--contours") {
+            contours_pattern = value;
+        } else if (option == "--cache") {
+            cache_folder = value;
+        } else if (option == "--cache-size") {
+            cache_size_mb = stod(value);
+            if (cache_size_mb <= 0) throw runtime_error("--cache-size must be positive.");
+        } else if (option == "--threads") {
+            threads = stoul(value);
+        } else if (option == "--costs") {
+            costs_file = value;
+        } else if (option == "--shard") {
+            size_t slash = value.find('/');
+            if (slash == string::npos) throw runtime_error("--shard expects k/n, e.g. 2/4.");
+            shard = stoul(value.substr(0, slash));
+            shards = stoul(value.substr(slash + 1));
+            if (shards == 0 || shard < 1 || shard > shards) throw runtime_error("--shard k/n needs 1 <= k <= n.");
+        } else if (option == "--only") {
+            only_file = value;
+        } else if (option == "--crs") {
+            throw runtime_error("--crs is not used in batch mode, each airfield gets its own.");
+        } else {
+            base.setOption(option, value);
+        }
+    }
+}
+
+SectorParams::SectorParams(int argc, char* argv[]) {
+    if (argc < 4) {
+        throw runtime_error("Not enough arguments provided. Expected format: ./compute sectors sectors.asc sectors.geojson [--colors 7] [--simplify d] [--min-area a] [--adjacency-distance d]");
+    }
+    input = argv[2];
+    output = argv[3];
+
+    for (int i = 4; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            throw runtime_error("Missing value for option " + option);
+        }
+        string value = argv[i + 1];
+
+        if (option == "--colors") {
+            colors = stoi(value);
+            if (colors < 1) throw runtime_error("--colors must be at least 1.");
+        } else if (option == "--simplify") {
+            simplify = stod(value);
+        } else if (option == "--min-area") {
+            min_area = stod(value);
+        } else if (option == "--adjacency-distance") {
+            adjacency_distance = stod(value);
+        } else {
+            throw runtime_error("Unknown option " + option);
+        }
+    }
+}
+
+HillshadeParams::HillshadeParams(int argc, char* argv[]) {
+    if (argc < 4) {
+        throw runtime_error("Not enough arguments provided. Expected format: ./compute hillshade dem4326.asc tiles.pack [--cellsize 100] [--min-zoom 1] [--max-zoom 12] [--azimuth 315] [--altitude 45] [--z-slopes 1.4] [--z-shades 2]");
+    }
+    input = argv[2];
+    output = argv[3];
+
+    for (int i = 4; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            throw runtime_error("Missing value for option " + option);
+        }
+        string value = argv[i + 1];
+
+        if (option == "--cellsize") {
+            cellsize = stod(value);
+            if (cellsize <= 0) throw runtime_error("--cellsize must be positive.");
+        } else if (option == "--min-zoom") {
+            min_zoom = stoi(value);
+        } else if (option == "--max-zoom") {
+            max_zoom = stoi(value);
+        } else if (option == "--azimuth") {
+            azimuth = stod(value);
+        } else if (option == "--altitude") {
+            altitude = stod(value);
+        } else if (option == "--z-slopes") {
+            z_slopes = stod(value);
+        } else if (option == "--z-shades") {
+            z_shades = stod(value);
+        } else {
+            throw runtime_error("Unknown option " + option);
+        }
+    }
+    if (min_zoom < 0 || max_zoom > 24 || min_zoom > max_zoom) {
+        throw runtime_error("Invalid zoom range.");
+    }
+}
+
+WarpParams::WarpParams(int argc, char* argv[]) {
+    if (argc < 5) {
+        throw runtime_error("Not enough arguments provided. Expected format: ./compute warp output_sub.asc crs.txt output_sub4326.asc [--resolution 0.0009]");
+    }
+    input = argv[2];
+    crs_file = argv[3];
+    output = argv[4];
+
+    for (int i = 5; i < argc; i += 2) {
+        string option = argv[i];
+        if (i + 1 >= argc) {
+            throw runtime_error("Missing value for option " + option);
+        }
+        string value = argv[i + 1];
+
+        if (option == "--resolution") {
+            resolution = stod(value);
+            if (resolution <= 0) throw runtime_error("--resolution must be positive.");
+        } else {
+            throw runtime_error("Unknown option " + option);
+        }
+    }
+}
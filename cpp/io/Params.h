@@ -3,6 +3,7 @@
 
 #include <cstddef>
 #include <string>
+#include <vector>
 using namespace std;
 
 class Params {
@@ -13,7 +14,78 @@ class Params {
             xllcorner, yllcorner;
         string output_path, topology, exportPasses;
 
+        // optional "--flag value" arguments after the positional ones
+        string crs_file, contours_file, contour_format = "geojson";
+        float contour_height = 100;
+        float simplify = 0;     // Douglas-Peucker tolerance, in cells
+        bool fixed_point = false;   // propagation in integer decimetres (Cell::altitude_dm)
+        size_t neighbours = 4;      // 4 or 8 (with the diagonals) connected propagation
+        string checkpoint_file;     // propagation state written periodically, to resume after a crash
+        double checkpoint_every = 60;   // seconds between checkpoints
+        bool resume = false;        // start from checkpoint_file when it matches
+        string preview_file;        // coarse-to-fine frames of the result, "-" = stdout
+        vector<size_t> preview_levels = {8, 4, 2};  // block sizes of the frames before the full one
+
+        Params() {}
+
         Params(int argc, char* argv[]);
+
+        // one "--flag value" pair, throws on unknown flags
+        void setOption(const string& option, const string& value);
+
+    private:
+        void parseOptions(int argc, char* argv[], int first);
+};
+
+// ./compute batch topography4326.asc airfields.csv finesse distSol securite nodataltitude
+//                 calculation_folder exportPasses [--option value ...]
+// airfields.csv holds "x,y,name" lines (lon, lat in degrees) after a header line.
+class BatchParams {
+    public:
+        string topography, airfields_file, calculation_folder;
+        float cellsize = 100;       // metres, of the per-airfield TM grids
+        Params base;                // shared by every airfield; home, output and crs are set per airfield
+        string contours_pattern;    // "{name}" is replaced by the airfield name
+        string cache_folder;        // content-addressed results shared across runs, empty = none
+        double cache_size_mb = 2048;    // least recently used results beyond this are deleted
+        size_t threads = 0;         // airfields computed at once, 0 = one per core
+        string costs_file;          // measured run times of the airfields, to start the longest first
+        size_t shard = 0, shards = 0;   // --shard k/n: airfields k, k+n, k+2n... (1-based), 0 = all
+        string only_file;           // --only: names of the airfields to run, one per line
+
+        BatchParams(int argc, char* argv[]);
+};
+
+// ./compute sectors sectors.asc sectors.geojson [--option value ...]
+class SectorParams {
+    public:
+        string input, output;
+        int colors = 7;
+        double simplify = -1;               // map units, -1 = 3 cells
+        double min_area = 0;                // map units²
+        double adjacency_distance = 0;      // map units, sectors closer than this get different colours
+
+        SectorParams(int argc, char* argv[]);
+};
+
+// ./compute hillshade dem4326.asc tiles.pack [--option value ...]
+class HillshadeParams {
+    public:
+        string input, output;
+        double cellsize = 100;              // metres, EPSG:3857 grid the shading is computed on
+        int min_zoom = 1, max_zoom = 12;
+        double azimuth = 315, altitude = 45, z_slopes = 1.4, z_shades = 2;
+
+        HillshadeParams(int argc, char* argv[]);
+};
+
+// ./compute warp output_sub.asc crs.txt output_sub4326.asc [--resolution 0.0009]
+class WarpParams {
+    public:
+        string input, crs_file, output;
+        double resolution = 0.0009;         // degrees
+
+        WarpParams(int argc, char* argv[]);
 };
 
 #endif // PARAMS_H
\ No newline at end of file
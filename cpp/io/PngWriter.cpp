@@ -0,0 +1,91 @@
+#include "PngWriter.h"
+#include "Deflate.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+namespace {
+    class CrcTable {
+        public:
+            uint32_t v[256];
+
+            CrcTable() {
+                for (uint32_t k = 0; k < 256; ++k) {
+                    uint32_t c = k;
+                    for (int bit = 0; bit < 8; ++bit) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    v[k] = c;
+                }
+            }
+    };
+
+    uint32_t crc32(const uint8_t* data, size_t n) {
+        static const CrcTable table;    // thread-safe initialisation, tiles are encoded in parallel
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t k = 0; k < n; ++k) crc = table.v[(crc ^ data[k]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void chunk(vector<uint8_t>& png, const char* type, const vector<uint8_t>& body) {
+        uint32_t length = static_cast<uint32_t>(body.size());
+        for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(length >> shift));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), body.begin(), body.end());
+        uint32_t crc = crc32(png.data() + start, png.size() - start);
+        for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(crc >> shift));
+    }
+
+    uint8_t paeth(int a, int b, int c) {
+        int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+        if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+        return static_cast<uint8_t>(pb <= pc ? b : c);
+    }
+}
+
+
+vector<uint8_t> encode_png_gray(const uint8_t* pixels, size_t width, size_t height) {
+    // filtered scanlines
+    vector<uint8_t> raw;
+    raw.reserve((width + 1) * height);
+    vector<uint8_t> candidate(width), best(width);
+    vector<uint8_t> zero(width, 0);
+    for (size_t i = 0; i < height; ++i) {
+        const uint8_t* row = pixels + i * width;
+        const uint8_t* up = i > 0 ? pixels + (i - 1) * width : zero.data();
+        long bestScore = -1;
+        uint8_t bestFilter = 0;
+        for (uint8_t filter = 0; filter < 5; ++filter) {
+            long score = 0;
+            for (size_t j = 0; j < width; ++j) {
+                int a = j > 0 ? row[j - 1] : 0, b = up[j], c = j > 0 ? up[j - 1] : 0;
+                uint8_t predictor = filter == 0 ? 0 : filter == 1 ? a : filter == 2 ? b
+                                  : filter == 3 ? static_cast<uint8_t>((a + b) / 2) : paeth(a, b, c);
+                candidate[j] = static_cast<uint8_t>(row[j] - predictor);
+                score += static_cast<int8_t>(candidate[j]) < 0 ? -static_cast<int8_t>(candidate[j]) : candidate[j];
+            }
+            if (bestScore < 0 || score < bestScore) {
+                bestScore = score;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        raw.push_back(bestFilter);
+        raw.insert(raw.end(), best.begin(), best.end());
+    }
+
+    static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    vector<uint8_t> png(SIGNATURE, SIGNATURE + 8);
+    vector<uint8_t> header(13, 0);
+    for (int k = 0; k < 4; ++k) {
+        header[k] = static_cast<uint8_t>(width >> (24 - 8 * k));
+        header[4 + k] = static_cast<uint8_t>(height >> (24 - 8 * k));
+    }
+    header[8] = 8;    // bit depth, colour type 0 (grayscale)
+    chunk(png, "IHDR", header);
+    chunk(png, "IDAT", zlib_compress(raw));
+    chunk(png, "IEND", vector<uint8_t>());
+    return png;
+}
@@ -0,0 +1,14 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// 8-bit grayscale PNG of a row-major image, in memory. Self-contained deflate
+// (fixed Huffman codes, LZ77 over a 32 KiB window) so that compute needs no zlib;
+// each row gets the PNG filter with the smallest sum of absolute residuals.
+vector<uint8_t> encode_png_gray(const uint8_t* pixels, size_t width, size_t height);
+
+#endif // PNGWRITER_H
@@ -0,0 +1,48 @@
+#include "PreviewFrames.h"
+
+#include <cstdint>
+#include <stdexcept>
+using namespace std;
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+    const char FRAME_MAGIC[4] = {'M', 'P', 'V', '1'};
+
+    template <typename T>
+    bool put(FILE* out, const T& value) {
+        return fwrite(&value, sizeof(T), 1, out) == 1;
+    }
+}
+
+
+PreviewWriter::PreviewWriter(const string& path) : path(path) {
+    if (path == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);   // no \n -> \r\n in the floats
+#endif
+        out = stdout;
+        owned = false;
+    } else {
+        out = fopen(path.c_str(), "wb");
+        owned = true;
+        if (!out) throw runtime_error("Unable to write " + path);
+    }
+}
+
+PreviewWriter::~PreviewWriter() {
+    if (owned) fclose(out);
+}
+
+void PreviewWriter::write(const AscGrid& grid, size_t factor, bool final) {
+    bool ok = fwrite(FRAME_MAGIC, 1, 4, out) == 4 &&
+              put(out, static_cast<uint32_t>(factor)) && put(out, static_cast<uint32_t>(final ? 1 : 0)) &&
+              put(out, static_cast<uint32_t>(grid.ncols)) && put(out, static_cast<uint32_t>(grid.nrows)) &&
+              put(out, grid.xllcorner) && put(out, grid.yllcorner) && put(out, grid.cellsize) &&
+              put(out, grid.nodata) &&
+              fwrite(grid.data.data(), sizeof(float), grid.data.size(), out) == grid.data.size();
+    if (!ok || fflush(out) != 0) throw runtime_error("Preview reader of " + path + " went away.");
+}
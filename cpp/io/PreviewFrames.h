@@ -0,0 +1,36 @@
+#ifndef PREVIEWFRAMES_H
+#define PREVIEWFRAMES_H
+
+#include "AscGrid.h"
+#include <cstddef>
+#include <cstdio>
+#include <string>
+using namespace std;
+
+// Frames of --preview: the result of one airfield at successively finer resolutions, for
+// a reader displaying each as soon as it arrives (src/preview.py). A frame is
+//   "MPV1" | factor, final, ncols, nrows (uint32) | xllcorner, yllcorner, cellsize (double)
+//   | nodata (float) | ncols * nrows values (float, row-major, row 0 = north)
+// in the byte order of the machine, without padding. factor is the block size the frame
+// was solved on (1 = full resolution); final is 1 on the last frame. Each frame is flushed
+// as a whole, so the reader never waits on half of one.
+class PreviewWriter {
+    public:
+        // "-" writes to stdout
+        PreviewWriter(const string& path);
+
+        ~PreviewWriter();
+
+        PreviewWriter(const PreviewWriter&) = delete;
+        PreviewWriter& operator=(const PreviewWriter&) = delete;
+
+        // throws when the reader went away, which stops the airfield
+        void write(const AscGrid& grid, size_t factor, bool final);
+
+    private:
+        FILE* out;
+        bool owned;
+        string path;
+};
+
+#endif // PREVIEWFRAMES_H
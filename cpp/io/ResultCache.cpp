@@ -0,0 +1,246 @@
+#include "ResultCache.h"
+#include "Deflate.h"
+#include "HgtMosaic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#ifdef _WIN32
+#include <sys/utime.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
+
+namespace {
+    const char MAGIC[4] = {'M', 'C', 'R', 'C'};
+    const int CHAIN = 8;    // ~40% faster than the PNG setting for ~6% larger text results
+
+    inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    inline uint64_t fmix(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+
+    // MurmurHash3_x64_128
+    string murmur3(const uint8_t* data, size_t n, uint64_t seed) {
+        const uint64_t c1 = 0x87c37b91114253d5ull, c2 = 0x4cf5ad432745937full;
+        uint64_t h1 = seed, h2 = seed;
+        size_t blocks = n / 16;
+        for (size_t b = 0; b < blocks; ++b) {
+            uint64_t k1, k2;
+            memcpy(&k1, data + 16 * b, 8);
+            memcpy(&k2, data + 16 * b + 8, 8);
+            k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+            h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+            k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+            h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+        }
+        const uint8_t* tail = data + 16 * blocks;
+        uint64_t k1 = 0, k2 = 0;
+        switch (n & 15) {
+            case 15: k2 ^= static_cast<uint64_t>(tail[14]) << 48; // fall through
+            case 14: k2 ^= static_cast<uint64_t>(tail[13]) << 40; // fall through
+            case 13: k2 ^= static_cast<uint64_t>(tail[12]) << 32; // fall through
+            case 12: k2 ^= static_cast<uint64_t>(tail[11]) << 24; // fall through
+            case 11: k2 ^= static_cast<uint64_t>(tail[10]) << 16; // fall through
+            case 10: k2 ^= static_cast<uint64_t>(tail[9]) << 8;   // fall through
+            case 9:  k2 ^= static_cast<uint64_t>(tail[8]);
+                     k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2; // fall through
+            case 8:  k1 ^= static_cast<uint64_t>(tail[7]) << 56;  // fall through
+            case 7:  k1 ^= static_cast<uint64_t>(tail[6]) << 48;  // fall through
+            case 6:  k1 ^= static_cast<uint64_t>(tail[5]) << 40;  // fall through
+            case 5:  k1 ^= static_cast<uint64_t>(tail[4]) << 32;  // fall through
+            case 4:  k1 ^= static_cast<uint64_t>(tail[3]) << 24;  // fall through
+            case 3:  k1 ^= static_cast<uint64_t>(tail[2]) << 16;  // fall through
+            case 2:  k1 ^= static_cast<uint64_t>(tail[1]) << 8;   // fall through
+            case 1:  k1 ^= static_cast<uint64_t>(tail[0]);
+                     k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+        }
+        h1 ^= n; h2 ^= n;
+        h1 += h2; h2 += h1;
+        h1 = fmix(h1); h2 = fmix(h2);
+        h1 += h2; h2 += h1;
+
+        char hex[33];
+        snprintf(hex, sizeof(hex), "%016llx%016llx", static_cast<unsigned long long>(h1),
+                 static_cast<unsigned long long>(h2));
+        return hex;
+    }
+
+    vector<uint8_t> readBytes(const string& path) {
+        ifstream in(path, ios::binary);
+        if (!in) throw runtime_error("Unable to open file " + path);
+        return vector<uint8_t>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    void putInt(vector<uint8_t>& out, uint64_t v, int bytes) {
+        for (int k = 0; k < bytes; ++k) out.push_back(static_cast<uint8_t>(v >> (8 * k)));
+    }
+
+    uint64_t getInt(const vector<uint8_t>& in, size_t& p, int bytes) {
+        if (p + bytes > in.size()) throw runtime_error("Truncated cache file.");
+        uint64_t v = 0;
+        for (int k = 0; k < bytes; ++k) v |= static_cast<uint64_t>(in[p + k]) << (8 * k);
+        p += bytes;
+        return v;
+    }
+
+    class CachedFile {
+        public:
+            string path;
+            uint64_t size;
+            long long mtime;
+    };
+
+    vector<CachedFile> listResults(const string& folder) {
+        vector<CachedFile> found;
+#ifdef _WIN32
+        WIN32_FIND_DATAA entry;
+        HANDLE search = FindFirstFileA((folder + "/*.mcr").c_str(), &entry);
+        if (search == INVALID_HANDLE_VALUE) return found;
+        do {
+            string path = folder + "/" + entry.cFileName;
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0) found.push_back({path, static_cast<uint64_t>(info.st_size), info.st_mtime});
+        } while (FindNextFileA(search, &entry));
+        FindClose(search);
+#else
+        DIR* dir = opendir(folder.c_str());
+        if (!dir) return found;
+        while (dirent* entry = readdir(dir)) {
+            string name = entry->d_name;
+            if (name.size() < 4 || name.compare(name.size() - 4, 4, ".mcr") != 0) continue;
+            string path = folder + "/" + name;
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0) found.push_back({path, static_cast<uint64_t>(info.st_size), info.st_mtime});
+        }
+        closedir(dir);
+#endif
+        return found;
+    }
+}
+
+
+ResultCache::ResultCache(const string& folder, uint64_t maxBytes) : folder(folder), maxBytes(maxBytes) {
+    make_directory(folder);
+}
+
+string ResultCache::key(const string& description, const AscGrid& dem) {
+    string text = description;
+    text += " dem " + to_string(dem.ncols) + "x" + to_string(dem.nrows) + " ";
+    text += murmur3(reinterpret_cast<const uint8_t*>(dem.data.data()), dem.data.size() * sizeof(float), 0);
+    return murmur3(reinterpret_cast<const uint8_t*>(text.data()), text.size(), 0);
+}
+
+bool ResultCache::restore(const string& key, const vector<pair<string, string>>& files) {
+    string path = folder + "/" + key + ".mcr";
+    ifstream probe(path, ios::binary);
+    if (!probe) return false;
+    probe.close();
+
+    map<string, pair<size_t, size_t>> records;     // name -> offset, size of its zlib stream
+    vector<uint8_t> blob;
+    try {
+        blob = readBytes(path);
+        if (blob.size() < 4 || memcmp(blob.data(), MAGIC, 4) != 0) return false;
+        size_t p = 4;
+        while (p < blob.size()) {
+            size_t length = static_cast<size_t>(getInt(blob, p, 4));
+            if (p + length > blob.size()) return false;
+            string name(reinterpret_cast<const char*>(blob.data()) + p, length);
+            p += length;
+            size_t size = static_cast<size_t>(getInt(blob, p, 8));
+            if (p + size > blob.size()) return false;
+            records[name] = make_pair(p, size);
+            p += size;
+        }
+    } catch (const exception&) {
+        return false;   // unreadable, e.g. deleted by another process meanwhile: recompute
+    }
+
+    vector<vector<uint8_t>> contents;
+    for (const auto& file : files) {
+        auto record = records.find(file.first);
+        if (record == records.end()) return false;
+        try {
+            contents.push_back(zlib_decompress(vector<uint8_t>(blob.begin() + record->second.first,
+                                                               blob.begin() + record->second.first + record->second.second)));
+        } catch (const exception&) {
+            return false;
+        }
+    }
+    for (size_t k = 0; k < files.size(); ++k) {
+        ofstream out(files[k].second, ios::binary);
+        if (!out.write(reinterpret_cast<const char*>(contents[k].data()), contents[k].size())) {
+            throw runtime_error("Unable to write " + files[k].second);
+        }
+    }
+#ifdef _WIN32
+    _utime(path.c_str(), nullptr);
+#else
+    utime(path.c_str(), nullptr);
+#endif
+    return true;
+}
+
+void ResultCache::store(const string& key, const vector<pair<string, string>>& files) {
+    vector<uint8_t> blob(MAGIC, MAGIC + 4);
+    for (const auto& file : files) {
+        vector<uint8_t> compressed = zlib_compress(readBytes(file.second), CHAIN);
+        putInt(blob, file.first.size(), 4);
+        blob.insert(blob.end(), file.first.begin(), file.first.end());
+        putInt(blob, compressed.size(), 8);
+        blob.insert(blob.end(), compressed.begin(), compressed.end());
+    }
+
+    string path = folder + "/" + key + ".mcr";
+    string temporary = path + "." + to_string(hash<thread::id>()(this_thread::get_id()) ^
+                                              chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        ofstream out(temporary, ios::binary);
+        if (!out.write(reinterpret_cast<const char*>(blob.data()), blob.size())) {
+            throw runtime_error("Unable to write " + temporary);
+        }
+    }
+    if (rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());     // stored by another process meanwhile
+    }
+
+    lock_guard<mutex> guard(lock);
+    evict(path);
+}
+
+// modification times are often whole seconds: the result just stored goes last
+void ResultCache::evict(const string& newest) {
+    vector<CachedFile> results = listResults(folder);
+    uint64_t total = 0;
+    for (const CachedFile& result : results) total += result.size;
+    if (total <= maxBytes) return;
+
+    sort(results.begin(), results.end(), [&](const CachedFile& a, const CachedFile& b) {
+        bool aNewest = a.path == newest, bNewest = b.path == newest;
+        return aNewest != bNewest ? bNewest : a.mtime < b.mtime;
+    });
+    for (const CachedFile& result : results) {
+        if (total <= maxBytes) break;
+        if (remove(result.path.c_str()) == 0) total -= result.size;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include "AscGrid.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Output files of compute batch airfields, addressed by the content they depend on (DEM
+// window values, glide parameters, home, output options) rather than by folder, so that
+// use cases and sessions sharing the cache folder reuse each other's airfields.
+// One "<key>.mcr" per result, little-endian:
+//   "MCRC" | records until EOF
+//   record = name length (uint32) | name | zlib size (uint64) | zlib stream of the file
+// A hit refreshes the file's modification time; after each store the least recently
+// used results are deleted until the folder fits the size limit. Results are written
+// to a temporary file and renamed, several processes may share the folder.
+class ResultCache {
+    public:
+        ResultCache(const string& folder, uint64_t maxBytes);
+
+        // 32 hex digits of a 128-bit MurmurHash3 of the description and the grid values
+        static string key(const string& description, const AscGrid& dem);
+
+        // writes every (name, path) file of the result; false when it is not cached
+        bool restore(const string& key, const vector<pair<string, string>>& files);
+
+        void store(const string& key, const vector<pair<string, string>>& files);
+
+    private:
+        string folder;
+        uint64_t maxBytes;
+        mutex lock;
+
+        void evict(const string& newest);
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,64 @@
+#include "SectorWriter.h"
+
+#include "../geo/Sectors.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+    void writeRing(ofstream& outputFile, const Ring& ring) {
+        char buffer[64];
+        outputFile << "[";
+        for (size_t k = 0; k < ring.x.size(); ++k) {
+            snprintf(buffer, sizeof(buffer), "%s[%.7f, %.7f]", k > 0 ? ", " : "", ring.x[k], ring.y[k]);
+            outputFile << buffer;
+        }
+        outputFile << "]";
+    }
+
+    void writePolygon(ofstream& outputFile, const SectorPolygon& polygon) {
+        outputFile << "[";
+        writeRing(outputFile, polygon.exterior);
+        for (const Ring& hole : polygon.holes) {
+            outputFile << ", ";
+            writeRing(outputFile, hole);
+        }
+        outputFile << "]";
+    }
+}
+
+
+void write_sectors_geojson(const vector<Sector>& sectors, const string& destinationFile) {
+    ofstream outputFile(destinationFile);
+
+    if (outputFile.is_open()) {
+        outputFile << "{\"type\": \"FeatureCollection\", \"features\": [";
+        bool first = true;
+        for (const Sector& sector : sectors) {
+            if (sector.polygons.empty()) continue;
+            if (!first) outputFile << ", ";
+            first = false;
+
+            outputFile << "{\"type\": \"Feature\", \"geometry\": ";
+            if (sector.polygons.size() == 1) {
+                outputFile << "{\"type\": \"Polygon\", \"coordinates\": ";
+                writePolygon(outputFile, sector.polygons[0]);
+            } else {
+                outputFile << "{\"type\": \"MultiPolygon\", \"coordinates\": [";
+                for (size_t p = 0; p < sector.polygons.size(); ++p) {
+                    if (p > 0) outputFile << ", ";
+                    writePolygon(outputFile, sector.polygons[p]);
+                }
+                outputFile << "]";
+            }
+            outputFile << "}, \"properties\": {\"color_id\": " << sector.color << ", \"sector\": " << sector.id << "}}";
+        }
+        outputFile << "]}";
+        outputFile.close();
+    } else {
+        cerr << "Unable to open file " << destinationFile << " for writing." << endl;
+    }
+}
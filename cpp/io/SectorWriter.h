@@ -0,0 +1,13 @@
+#ifndef SECTORWRITER_H
+#define SECTORWRITER_H
+
+#include "../geo/Sectors.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+// One feature per sector, Polygon or MultiPolygon, with the "color_id" property read by
+// the sectors mapcss styles. Sectors without any polygon left are skipped.
+void write_sectors_geojson(const vector<Sector>& sectors, const string& destinationFile);
+
+#endif // SECTORWRITER_H
@@ -0,0 +1,48 @@
+#include "TilePack.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+    void putInt(vector<uint8_t>& out, uint32_t v) {
+        for (int k = 0; k < 4; ++k) out.push_back(static_cast<uint8_t>(v >> (8 * k)));
+    }
+}
+
+
+TilePackWriter::TilePackWriter(const string& path, double west, double south, double east, double north) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        throw runtime_error("Unable to open file " + path + " for writing.");
+    }
+    vector<uint8_t> header = {'M', 'C', 'T', 'P'};
+    for (double v : {west, south, east, north}) {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        putInt(header, static_cast<uint32_t>(bits));
+        putInt(header, static_cast<uint32_t>(bits >> 32));
+    }
+    fwrite(header.data(), 1, header.size(), file);
+}
+
+TilePackWriter::~TilePackWriter() {
+    fclose(file);
+}
+
+void TilePackWriter::add(int zoom, int column, int tmsRow, const vector<uint8_t>& data) {
+    vector<uint8_t> header;
+    putInt(header, static_cast<uint32_t>(zoom));
+    putInt(header, static_cast<uint32_t>(column));
+    putInt(header, static_cast<uint32_t>(tmsRow));
+    putInt(header, static_cast<uint32_t>(data.size()));
+
+    lock_guard<mutex> guard(lock);
+    fwrite(header.data(), 1, header.size(), file);
+    fwrite(data.data(), 1, data.size(), file);
+}
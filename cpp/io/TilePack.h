@@ -0,0 +1,29 @@
+#ifndef TILEPACK_H
+#define TILEPACK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Encoded map tiles appended to one file, for utils/hillshade.py to copy into an
+// MBTiles database (compute does not link sqlite). Little-endian layout:
+//   "MCTP" | west south east north (float64, degrees) | records until EOF
+//   record = zoom, column, row (int32, TMS row as in MBTiles) | size (uint32) | bytes
+// add() may be called from several threads.
+class TilePackWriter {
+    public:
+        TilePackWriter(const string& path, double west, double south, double east, double north);
+
+        ~TilePackWriter();
+
+        void add(int zoom, int column, int tmsRow, const vector<uint8_t>& data);
+
+    private:
+        FILE* file;
+        mutex lock;
+};
+
+#endif // TILEPACK_H
@@ -1,37 +1,414 @@
 #include "data/Cell.h"
 #include "data/Matrix.h"
+#include "data/Parallel.h"
+#include "geo/Hillshade.h"
+#include "geo/LocalDem.h"
+#include "geo/Sectors.h"
+#include "geo/TransverseMercator.h"
+#include "geo/Warp.h"
+#include "io/Airfields.h"
+#include "io/AscGrid.h"
+#include "io/BatchCosts.h"
+#include "io/HgtMosaic.h"
 #include "io/Params.h"
+#include "io/PreviewFrames.h"
+#include "io/ResultCache.h"
+#include "io/SectorWriter.h"
+#include "io/TilePack.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 using namespace std;
 
 
-int main(int argc, char* argv[]) {
+// Polygons and colours of the merged sectors raster
+static int run_sectors(int argc, char* argv[]) {
+    SectorParams params(argc, argv);
+    AscGrid grid(params.input);
 
-    try {
-        Params params(argc, argv);
-        Matrix M(params);
+    double simplify = params.simplify < 0 ? 3 * grid.cellsize : params.simplify;
+    vector<Sector> sectors = trace_sectors(grid, params.min_area, simplify);
+
+    size_t gapCells = static_cast<size_t>(ceil(params.adjacency_distance / grid.cellsize));
+    color_sectors(sectors, sector_adjacency(grid, sectors, gapCells), params.colors);
+
+    write_sectors_geojson(sectors, params.output);
+    return 0;
+}
+
+
+// Shaded relief tiles of an EPSG:4326 DEM, packed for utils/hillshade.py
+static int run_hillshade(int argc, char* argv[]) {
+    HillshadeParams params(argc, argv);
+    AscGrid mercator = resample_to_mercator(AscGrid(params.input), params.cellsize);
+
+    ShadeParams shade;
+    shade.azimuth = params.azimuth;
+    shade.altitude = params.altitude;
+    shade.z_slopes = params.z_slopes;
+    shade.z_shades = params.z_shades;
+    vector<uint8_t> composite = shade_composite(mercator, shade);
+
+    double west, south, east, north;
+    mercator_bounds(mercator, west, south, east, north);
+    TilePackWriter out(params.output, west, south, east, north);
+    render_tiles(composite, mercator, params.min_zoom, params.max_zoom, out);
+    return 0;
+}
+
+
+// Local TM grid of one airfield resampled to EPSG:4326, as src/warp.py
+static int run_warp(int argc, char* argv[]) {
+    WarpParams params(argc, argv);
+    AscGrid warped = warp_tm_to_wgs84(AscGrid(params.input), TransverseMercator::fromFile(params.crs_file),
+                                      params.resolution);
+    warped.write(params.output, 6);
+    return 0;
+}
+
+
+static bool exports_passes(const Params& params) {
+    return params.exportPasses == "true" || params.exportPasses == "1" || atoi(params.exportPasses.c_str()) != 0;
+}
+
+
+// --preview -: stdout carries the frames, the text output goes to stderr
+static void free_stdout_for_preview(const Params& params) {
+    if (params.preview_file == "-") cout.rdbuf(cerr.rdbuf());
+}
 
-        M.mat[M.homei][M.homej].initialize(params);
+// --preview of an airfield whose outputs are already there: the full resolution frame only
+static void preview_existing(const Params& params, const string& folder) {
+    if (params.preview_file.empty()) return;
+    PreviewWriter(params.preview_file).write(AscGrid(folder + "/output_sub.asc"), 1, true);
+}
 
-        M.addGroundClearance(params);
 
+// Propagation and outputs of one airfield, home at the TM origin
+static void run_airfield(Matrix& M, Params& params) {
+    M.mat[M.homei][M.homej].initialize(params, M.index(M.homei, M.homej));
+
+    M.addGroundClearance(params);
+
+    // coarse frames first, each as soon as it is solved; the full resolution one follows
+    unique_ptr<PreviewWriter> preview;
+    if (!params.preview_file.empty()) {
+        preview.reset(new PreviewWriter(params.preview_file));
+        for (size_t factor : params.preview_levels) preview->write(M.coarse_output_grid(params, factor), factor, false);
+    }
+
+    if (!params.checkpoint_file.empty()) {
+        M.calculate_safety_altitude_checkpointed(params);
+    } else {
         M.calculate_safety_altitude(params);
+    }
+
+    M.update_altitude_for_ground_cells(0);  //set ground altitude to 0 - useful for recombining all tiles
+    if (preview) preview->write(M.output_grid(params), 1, true);
+
+    M.write_output(params, params.output_path + "/output_sub.asc", false);  //ground altitude set to 0 - useful for recombining all tiles
+    M.write_output(params, params.output_path + "/local.asc", true);    //ground altitude set to nodata - ground transparent
+
+    if (!params.contours_file.empty()) {
+        if (params.crs_file.empty()) throw runtime_error("--contours needs --crs to reproject to EPSG:4326.");
+        M.write_contours_4326(params, params.contours_file);
+    }
+
+
+    if (exports_passes(params)){
+        M.detect_passes(params);
+        M.weight_passes(params);
+        M.write_mountain_passes(params,params.output_path + "/mountain_passes.csv");
+    }
+}
 
-        M.update_altitude_for_ground_cells(0);  //set ground altitude to 0 - useful for recombining all tiles
 
-        M.write_output(params, params.output_path + "/output_sub.asc", false);  //ground altitude set to 0 - useful for recombining all tiles
-        M.write_output(params, params.output_path + "/local.asc", true);    //ground altitude set to nodata - ground transparent
+// what the run time of a batch airfield depends on, for --costs (the name goes last, it
+// may hold spaces)
+static string cost_key(const Airfield& airfield, const BatchParams& batch) {
+    const Params& params = batch.base;
+    ostringstream key;
+    key << setprecision(9) << params.finesse << " " << params.distSol << " " << params.securite << " "
+        << params.nodataltitude << " " << batch.cellsize << " " << exports_passes(params) << " "
+        << !batch.contours_pattern.empty() << " "
+        << params.fixed_point << " " << params.neighbours << " " << airfield.x << " " << airfield.y << " "
+        << airfield.name;
+    return key.str();
+}
 
 
-        bool shouldExportPasses = (params.exportPasses == "true" || params.exportPasses == "1" || atoi(params.exportPasses.c_str()) != 0);
-        
-        if (shouldExportPasses){
-            M.detect_passes(params);
-            M.weight_passes(params);
-            M.write_mountain_passes(params,params.output_path + "/mountain_passes.csv");
+// the airfields of --shard k/n (every n-th from the k-th, in file order) and --only
+static vector<Airfield> select_airfields(const vector<Airfield>& airfields, const BatchParams& batch) {
+    vector<Airfield> selected;
+    for (size_t k = 0; k < airfields.size(); ++k) {
+        if (batch.shards == 0 || k % batch.shards == batch.shard - 1) selected.push_back(airfields[k]);
+    }
+    if (batch.only_file.empty()) return selected;
+
+    set<string> names;
+    ifstream in(batch.only_file);
+    if (!in) throw runtime_error("Unable to read " + batch.only_file);
+    string line;
+    while (getline(in, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+        if (!line.empty()) names.insert(line);
+    }
+    vector<Airfield> only;
+    for (const Airfield& airfield : selected) {
+        if (names.erase(airfield.name)) only.push_back(airfield);
+    }
+    for (const string& name : names) cerr << "--only: no airfield " << name << " in " << batch.airfields_file << endl;
+    return only;
+}
+
+static string json_string(const string& text) {
+    ostringstream out;
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (c < 0x20) out << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec;
+        else out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+// bundle.json of a --shard or --only run: what the folder holds and what it was computed
+// with, for utils/shards.py merge to check bundles against each other and the use case
+static void write_bundle(const BatchParams& batch, const string& topographyKey, const vector<Airfield>& airfields,
+                         const vector<string>& status, const vector<double>& seconds) {
+    const Params& params = batch.base;
+    string path = batch.calculation_folder + "/bundle.json";
+    ofstream out(path);
+    out << setprecision(17) << "{\n \"format\": 1,\n \"shard\": ";
+    if (batch.shards > 0) out << json_string(to_string(batch.shard) + "/" + to_string(batch.shards));
+    else out << "null";
+    out << ",\n \"only\": " << (batch.only_file.empty() ? string("null") : json_string(batch.only_file))
+        << ",\n \"topography\": {\"name\": " << json_string(batch.topography.substr(batch.topography.find_last_of("/\\") + 1))
+        << ", \"key\": " << json_string(topographyKey) << "}"
+        << ",\n \"parameters\": {\"finesse\": " << params.finesse << ", \"distSol\": " << params.distSol
+        << ", \"securite\": " << params.securite << ", \"nodataltitude\": " << params.nodataltitude
+        << ", \"cellsize\": " << batch.cellsize << ", \"exportPasses\": " << (exports_passes(params) ? "true" : "false")
+        << ", \"contours\": " << json_string(batch.contours_pattern) << ", \"contour_height\": " << params.contour_height
+        << ", \"simplify\": " << params.simplify << ", \"contour_format\": " << json_string(params.contour_format)
+        << ", \"fixed_point\": " << (params.fixed_point ? "true" : "false") << ", \"neighbours\": " << params.neighbours
+        << "},\n \"airfields\": [";
+    for (size_t k = 0; k < airfields.size(); ++k) {
+        out << (k ? ",\n  " : "\n  ") << "{\"name\": " << json_string(airfields[k].name) << ", \"x\": " << airfields[k].x
+            << ", \"y\": " << airfields[k].y << ", \"status\": " << json_string(status[k])
+            << ", \"seconds\": " << setprecision(4) << seconds[k] << setprecision(17) << "}";
+    }
+    out << "\n ]\n}\n";
+    if (!out) throw runtime_error("Unable to write " + path);
+}
+
+
+// Every airfield of a use case from the EPSG:4326 topography, in parallel across airfields:
+// local TM grid (src/extract_project_tm.py) straight into the Matrix, then run_airfield.
+// The airfield folders must exist; airfields with a local.asc already are skipped, unless
+// a --cache folder is given: results then come from it whenever their DEM window, glide
+// parameters and output options are the same, and are computed and stored otherwise.
+// The topography is an .asc file, or a folder of .hgt tiles of which each airfield
+// only reads the window its TM square covers.
+// "Finished <name>" is printed as soon as an airfield's outputs are in its folder, for
+// launch2.py to start warping it while the others are still being computed.
+// Airfields are started longest first (estimate_airfield_cost, calibrated with --costs),
+// so that a large one does not start last and keep a single core busy at the end.
+// With --shard k/n or --only, only those airfields run (one node of a larger run), their
+// folders are created and bundle.json describes the result (write_bundle).
+static int run_batch(int argc, char* argv[]) {
+    BatchParams batch(argc, argv);
+    unique_ptr<ResultCache> cache;
+    if (!batch.cache_folder.empty()) {
+        cache.reset(new ResultCache(batch.cache_folder, static_cast<uint64_t>(batch.cache_size_mb * 1024 * 1024)));
+    }
+    unique_ptr<HgtMosaic> tiles;
+    AscGrid topography;
+    if (is_directory(batch.topography)) tiles.reset(new HgtMosaic(batch.topography));
+    else topography.read(batch.topography);
+    free_stdout_for_preview(batch.base);
+    vector<Airfield> airfields = select_airfields(read_airfields(batch.airfields_file), batch);
+    if (!batch.base.preview_file.empty() && airfields.size() != 1) {
+        throw runtime_error("--preview needs a single airfield, not " + to_string(airfields.size()) + ".");
+    }
+    const bool bundle = batch.shards > 0 || !batch.only_file.empty();
+    if (bundle) {
+        make_directory(batch.calculation_folder);
+        for (const Airfield& airfield : airfields) make_directory(batch.calculation_folder + "/" + airfield.name);
+    }
+    vector<string> status(airfields.size(), "failed");
+    vector<double> seconds(airfields.size(), 0);
+
+    CostHistory history(batch.costs_file);
+    if (history.size() > 0) cout << "Airfield costs calibrated on " << history.size() << " earlier runs." << endl;
+    vector<AirfieldCost> costs(airfields.size());
+    vector<double> predicted(airfields.size());
+    for (size_t k = 0; k < airfields.size(); ++k) {
+        const Airfield& airfield = airfields[k];
+        // an airfield whose lookup fails costs nothing here, its worker reports the error
+        try {
+            float elevation = tiles ? airfield_elevation(tiles->window(airfield.x, airfield.y, airfield.x, airfield.y),
+                                                         airfield.x, airfield.y)
+                                    : airfield_elevation(topography, airfield.x, airfield.y);
+            float radius = batch.base.finesse * (batch.base.nodataltitude - elevation) + 1;
+            if (radius < batch.cellsize) continue;      // fails straight away
+            TransverseMercator tm = TransverseMercator::fromProj4(local_tm_proj4(airfield.x, airfield.y));
+            costs[k] = estimate_airfield_cost(tiles ? nullptr : &topography, tm, batch.base, elevation, radius, batch.cellsize);
+            predicted[k] = history.predict(cost_key(airfield, batch), costs[k]);
+        } catch (const exception&) {
+            costs[k] = AirfieldCost();
+            predicted[k] = 0;
         }
+    }
+    vector<size_t> order = longest_first(predicted);
+
+    mutex logLock;
+    atomic<int> failures(0);
+    parallel_for_each(airfields.size(), [&](size_t n, size_t) {
+        const size_t k = order[n];
+        const Airfield& airfield = airfields[k];
+        auto started = chrono::steady_clock::now();
+        auto finished = [&](const char* how) {
+            status[k] = how;
+            seconds[k] = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+            if (status[k] == "computed") history.record(cost_key(airfield, batch), costs[k], seconds[k]);
+            lock_guard<mutex> guard(logLock);
+            cout << "Finished " << airfield.name << endl;
+        };
+        try {
+            string folder = batch.calculation_folder + "/" + airfield.name;
+            if (!cache && ifstream(folder + "/local.asc").good()) {
+                {
+                    lock_guard<mutex> guard(logLock);
+                    cout << "Output file already exists for " << airfield.name << ", skipping this airfield." << endl;
+                }
+                preview_existing(batch.base, folder);
+                finished("skipped");
+                return;
+            }
+
+            const AscGrid* dem = &topography;
+            AscGrid window;
+            if (tiles) {
+                window = tiles->window(airfield.x, airfield.y, airfield.x, airfield.y);
+                dem = &window;
+            }
+            float elevation = airfield_elevation(*dem, airfield.x, airfield.y);
+            float radius = batch.base.finesse * (batch.base.nodataltitude - elevation) + 1;
+            if (radius < batch.cellsize) {
+                throw runtime_error("airfield elevation is above the maximum altitude.");
+            }
+            {
+                lock_guard<mutex> guard(logLock);
+                cout << "Projecting to local Transverse Mercator: " << airfield.name << ": " << elevation
+                     << "m, Radius: " << static_cast<int>(radius / 1000) << "km" << endl;
+            }
+
+            Params params = batch.base;
+            params.output_path = folder;
+            params.crs_file = folder + "/crs.txt";
+            string proj4 = local_tm_proj4(airfield.x, airfield.y);
+            ofstream crs(params.crs_file);
+            if (!(crs << proj4)) throw runtime_error("Unable to write " + params.crs_file);
+            crs.close();
+            if (!batch.contours_pattern.empty()) {
+                string name = batch.contours_pattern;
+                size_t at = name.find("{name}");
+                if (at != string::npos) name.replace(at, 6, airfield.name);
+                params.contours_file = folder + "/" + name;
+            }
+            if (!params.checkpoint_file.empty()) params.checkpoint_file = folder + "/" + batch.base.checkpoint_file;
+
+            TransverseMercator tm = TransverseMercator::fromProj4(proj4);
+            if (tiles) {
+                double west, south, east, north;
+                tm_square_bounds(tm, radius, west, south, east, north);
+                window = tiles->window(west, south, east, north);
+            }
+
+            AscGrid local = extract_tm_dem(*dem, tm, radius, batch.cellsize);
+            if (!cache) {
+                Matrix M(params, local);
+                run_airfield(M, params);
+                finished("computed");
+                return;
+            }
 
+            // everything the output files depend on besides the DEM window
+            ostringstream description;
+            description << setprecision(9) << "batch 1 " << Matrix::PROPAGATION_VERSION << " " << proj4 << " "
+                        << params.finesse << " " << params.distSol << " " << params.securite << " " << params.nodataltitude << " "
+                        << exports_passes(params) << " " << !params.contours_file.empty() << " "
+                        << params.contour_height << " " << params.simplify << " " << params.contour_format << " "
+                        << params.fixed_point << " " << params.neighbours << " "
+                        << local.xllcorner << " " << local.yllcorner << " " << local.cellsize;
+            string key = ResultCache::key(description.str(), local);
+            vector<pair<string, string>> files = {{"output_sub.asc", folder + "/output_sub.asc"},
+                                                  {"local.asc", folder + "/local.asc"}};
+            if (!params.contours_file.empty()) files.push_back(make_pair("contours", params.contours_file));
+            if (exports_passes(params)) files.push_back(make_pair("mountain_passes.csv", folder + "/mountain_passes.csv"));
+
+            if (cache->restore(key, files)) {
+                {
+                    lock_guard<mutex> guard(logLock);
+                    cout << "Restored " << airfield.name << " from the result cache." << endl;
+                }
+                preview_existing(params, folder);
+                finished("restored");
+                return;
+            }
+            Matrix M(params, local);
+            run_airfield(M, params);
+            cache->store(key, files);
+            finished("computed");
+        } catch (const exception& e) {
+            lock_guard<mutex> guard(logLock);
+            cerr << "Error for " << airfield.name << ": " << e.what() << endl;
+            ++failures;
+        }
+    }, batch.threads);
+    history.save();
+    if (bundle) write_bundle(batch, tiles ? string() : ResultCache::key("topography", topography), airfields, status, seconds);
+    return failures > 0 ? 1 : 0;
+}
+
+
+int main(int argc, char* argv[]) {
+
+    try {
+        // what src/mosaic.py keys the merged mosaic on
+        if (argc > 1 && string(argv[1]) == "--version") {
+            cout << Matrix::PROPAGATION_VERSION << endl;
+            return 0;
+        }
+        if (argc > 1 && string(argv[1]) == "sectors") {
+            return run_sectors(argc, argv);
+        }
+        if (argc > 1 && string(argv[1]) == "hillshade") {
+            return run_hillshade(argc, argv);
+        }
+        if (argc > 1 && string(argv[1]) == "warp") {
+            return run_warp(argc, argv);
+        }
+        if (argc > 1 && string(argv[1]) == "batch") {
+            return run_batch(argc, argv);
+        }
+
+        Params params(argc, argv);
+        free_stdout_for_preview(params);
+        Matrix M(params);
+        run_airfield(M, params);
 
         // cout << "calcul "<<params.output_path<<" fini"<<endl;
 
@@ -40,4 +417,4 @@ int main(int argc, char* argv[]) {
         cerr << "Error: " << e.what() << endl;
         return 1;
     }
-}
\ No newline at end of file
+}
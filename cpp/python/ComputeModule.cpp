@@ -0,0 +1,394 @@
+// compute_ext: the compute binary as a Python extension module, results handed to NumPy
+// without copies. See the README for the build command.
+//
+//   header, dem = compute_ext.read_asc("projected.asc")
+//   result = compute_ext.compute_airfield(dem, header, 20, 100, 250, 5000, passes=True)
+//   results = compute_ext.compute_batch("topography4326.asc", [(6.5, 45.3, "A")], 20, 100, 250, 5000)
+//
+// Arrays are built over vectors filled by the C++ code, which they own through a capsule
+// (no copy, freed with the array). The Matrix keeps its cells in one allocation per row,
+// so the results are gathered once into such a vector, in the layout write_output would
+// have turned into text. The GIL is released while computing.
+#define PY_SSIZE_T_CLEAN
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <Python.h>
+#include <numpy/arrayobject.h>
+
+#include "../data/Matrix.h"
+#include "../data/Parallel.h"
+#include "../geo/LocalDem.h"
+#include "../geo/TransverseMercator.h"
+#include "../io/Airfields.h"
+#include "../io/AscGrid.h"
+#include "../io/HgtMosaic.h"
+#include "../io/Params.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <utility>
+#include <vector>
+using namespace std;
+
+namespace {
+    template <class T>
+    void deleteOwned(PyObject* capsule) {
+        delete static_cast<vector<T>*>(PyCapsule_GetPointer(capsule, "compute_ext.buffer"));
+    }
+
+    // array of `descr` over the buffer of `data`, which the array then owns
+    template <class T>
+    PyObject* toNumpy(vector<T>&& data, int nd, npy_intp* dims, PyArray_Descr* descr) {
+        vector<T>* owned = new vector<T>(move(data));
+        PyObject* array = PyArray_NewFromDescr(&PyArray_Type, descr, nd, dims, nullptr, owned->data(),
+                                               NPY_ARRAY_CARRAY, nullptr);
+        if (!array) {
+            delete owned;
+            return nullptr;
+        }
+        PyObject* capsule = PyCapsule_New(owned, "compute_ext.buffer", deleteOwned<T>);
+        if (!capsule || PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array), capsule) < 0) {
+            Py_XDECREF(capsule);
+            Py_DECREF(array);
+            if (!capsule) delete owned;
+            return nullptr;
+        }
+        return array;
+    }
+
+    PyObject* gridArray(AscGrid& grid) {
+        npy_intp dims[2] = {static_cast<npy_intp>(grid.nrows), static_cast<npy_intp>(grid.ncols)};
+        return toNumpy(move(grid.data), 2, dims, PyArray_DescrFromType(NPY_FLOAT32));
+    }
+
+    // the keys of read_asc in src/extract_project_tm.py
+    PyObject* headerDict(const AscGrid& grid) {
+        return Py_BuildValue("{s:n,s:n,s:d,s:d,s:d,s:d}", "ncols", static_cast<Py_ssize_t>(grid.ncols),
+                             "nrows", static_cast<Py_ssize_t>(grid.nrows), "xllcorner", grid.xllcorner,
+                             "yllcorner", grid.yllcorner, "cellsize", grid.cellsize,
+                             "nodata_value", static_cast<double>(grid.nodata));
+    }
+
+    // structured array (x, y, weight) of write_mountain_passes
+    PyObject* passesArray(vector<MountainPass>&& passes) {
+        PyObject* fields = Py_BuildValue("[(s,s),(s,s),(s,s)]", "x", "<f4", "y", "<f4", "weight", "<u4");
+        PyArray_Descr* descr = nullptr;
+        int ok = fields && PyArray_DescrConverter(fields, &descr);
+        Py_XDECREF(fields);
+        if (!ok) return nullptr;
+        npy_intp dims[1] = {static_cast<npy_intp>(passes.size())};
+        return toNumpy(move(passes), 1, dims, descr);
+    }
+
+    // options of the binary that apply in memory; the others (--checkpoint, --resume,
+    // --preview) need files or output the module has not
+    const vector<string> AIRFIELD_OPTIONS = {"--crs", "--contours", "--contour-height", "--simplify",
+                                             "--contour-format", "--fixed-point", "--neighbours"};
+    // contours need one file per airfield
+    const vector<string> BATCH_OPTIONS = {"--fixed-point", "--neighbours"};
+
+    // Params from the keyword arguments; options are the binary's "--flag": value pairs,
+    // each one of `allowed`
+    bool buildParams(Params& params, float finesse, float distSol, float securite, float nodataltitude,
+                     PyObject* options, const vector<string>& allowed, const char* function) {
+        params.finesse = finesse;
+        params.distSol = distSol;
+        params.securite = securite;
+        params.nodataltitude = nodataltitude;
+        params.homex = params.homey = 0;
+        if (!options || options == Py_None) return true;
+        if (!PyDict_Check(options)) {
+            PyErr_SetString(PyExc_TypeError, "options must be a dict of \"--flag\": value");
+            return false;
+        }
+        PyObject *key, *value;
+        Py_ssize_t position = 0;
+        while (PyDict_Next(options, &position, &key, &value)) {
+            PyObject* keyText = PyObject_Str(key);
+            PyObject* valueText = PyObject_Str(value);
+            if (!keyText || !valueText) {
+                Py_XDECREF(keyText);
+                Py_XDECREF(valueText);
+                return false;
+            }
+            // NULL, with the exception set, for strings that cannot be encoded (lone surrogates)
+            const char* keyUtf8 = PyUnicode_AsUTF8(keyText);
+            const char* valueUtf8 = keyUtf8 ? PyUnicode_AsUTF8(valueText) : nullptr;
+            string option = keyUtf8 ? keyUtf8 : "", text = valueUtf8 ? valueUtf8 : "";
+            Py_DECREF(keyText);
+            Py_DECREF(valueText);
+            if (!valueUtf8) return false;
+            if (find(allowed.begin(), allowed.end(), option) == allowed.end()) {
+                PyErr_Format(PyExc_ValueError, "%s is not available from %s.", option.c_str(), function);
+                return false;
+            }
+            try {
+                params.setOption(option, text);
+            } catch (const exception& e) {
+                PyErr_SetString(PyExc_ValueError, e.what());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // run_airfield of main.cpp without the checkpoints, preview and output files
+    class Solved {
+        public:
+            AscGrid altitude;
+            vector<MountainPass> passes;
+    };
+
+    Solved solve(Matrix& M, Params& params, bool passes) {
+        M.mat[M.homei][M.homej].initialize(params, M.index(M.homei, M.homej));
+        M.addGroundClearance(params);
+        M.calculate_safety_altitude(params);
+        M.update_altitude_for_ground_cells(0);
+        Solved solved;
+        solved.altitude = M.output_grid(params);
+        if (!params.contours_file.empty()) M.write_contours_4326(params, params.contours_file);
+        if (passes) {
+            M.detect_passes(params);
+            M.weight_passes(params);
+            solved.passes = M.mountain_passes(params);
+        }
+        return solved;
+    }
+
+    // {"altitude": output_sub.asc, "header": its header, "passes": (x, y, weight)}
+    PyObject* resultDict(Solved& solved, bool passes) {
+        PyObject* result = PyDict_New();
+        PyObject* header = headerDict(solved.altitude);
+        PyObject* altitude = gridArray(solved.altitude);
+        PyObject* passArray = passes ? passesArray(move(solved.passes)) : (Py_INCREF(Py_None), Py_None);
+        bool ok = result && header && altitude && passArray &&
+                  PyDict_SetItemString(result, "altitude", altitude) == 0 &&
+                  PyDict_SetItemString(result, "header", header) == 0 &&
+                  PyDict_SetItemString(result, "passes", passArray) == 0;
+        Py_XDECREF(header);
+        Py_XDECREF(altitude);
+        Py_XDECREF(passArray);
+        if (!ok) {
+            Py_XDECREF(result);
+            return nullptr;
+        }
+        return result;
+    }
+
+    bool isDirectory(const string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+    }
+}
+
+
+static PyObject* read_asc(PyObject*, PyObject* args) {
+    const char* path;
+    if (!PyArg_ParseTuple(args, "s", &path)) return nullptr;
+    AscGrid grid;
+    string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        grid.read(path);
+    } catch (const exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+    PyObject* header = headerDict(grid);
+    PyObject* data = gridArray(grid);
+    if (!header || !data) {
+        Py_XDECREF(header);
+        Py_XDECREF(data);
+        return nullptr;
+    }
+    return Py_BuildValue("(NN)", header, data);
+}
+
+static PyObject* compute_airfield(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"dem", "header", "finesse", "dist_sol", "securite", "nodata_altitude",
+                                     "home", "passes", "options", nullptr};
+    PyObject *demObject, *header, *options = nullptr;
+    float finesse, distSol, securite, nodataltitude;
+    double homex = 0, homey = 0;
+    int passes = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO!ffff|(dd)pO", const_cast<char**>(keywords), &demObject,
+                                     &PyDict_Type, &header, &finesse, &distSol, &securite, &nodataltitude,
+                                     &homex, &homey, &passes, &options)) {
+        return nullptr;
+    }
+    Params params;
+    if (!buildParams(params, finesse, distSol, securite, nodataltitude, options, AIRFIELD_OPTIONS, "compute_airfield")) {
+        return nullptr;
+    }
+    params.homex = static_cast<float>(homex);
+    params.homey = static_cast<float>(homey);
+
+    PyArrayObject* dem = reinterpret_cast<PyArrayObject*>(
+        PyArray_FROMANY(demObject, NPY_FLOAT32, 2, 2, NPY_ARRAY_IN_ARRAY));
+    if (!dem) return nullptr;
+    AscGrid topography;
+    topography.nrows = static_cast<size_t>(PyArray_DIM(dem, 0));
+    topography.ncols = static_cast<size_t>(PyArray_DIM(dem, 1));
+    const char* keys[3] = {"xllcorner", "yllcorner", "cellsize"};
+    double* values[3] = {&topography.xllcorner, &topography.yllcorner, &topography.cellsize};
+    for (int k = 0; k < 3; ++k) {
+        PyObject* value = PyDict_GetItemString(header, keys[k]);
+        *values[k] = value ? PyFloat_AsDouble(value) : -1;
+        if (!value || PyErr_Occurred()) {
+            Py_DECREF(dem);
+            if (!PyErr_Occurred()) PyErr_Format(PyExc_KeyError, "header has no %s", keys[k]);
+            return nullptr;
+        }
+    }
+
+    Solved solved;
+    string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        // the Matrix copies the window into its cells as it would from projected.asc
+        const float* cells = static_cast<const float*>(PyArray_DATA(dem));
+        topography.data.assign(cells, cells + topography.nrows * topography.ncols);
+        Matrix M(params, topography);
+        topography.data = vector<float>();
+        solved = solve(M, params, passes != 0);
+    } catch (const exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    Py_DECREF(dem);
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+    return resultDict(solved, passes != 0);
+}
+
+static PyObject* compute_batch(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"topography", "airfields", "finesse", "dist_sol", "securite",
+                                     "nodata_altitude", "cellsize", "passes", "options", nullptr};
+    const char* path;
+    PyObject *airfieldList, *options = nullptr;
+    float finesse, distSol, securite, nodataltitude, cellsize = 100;
+    int passes = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sOffff|fpO", const_cast<char**>(keywords), &path,
+                                     &airfieldList, &finesse, &distSol, &securite, &nodataltitude, &cellsize,
+                                     &passes, &options)) {
+        return nullptr;
+    }
+    Params base;
+    if (!buildParams(base, finesse, distSol, securite, nodataltitude, options, BATCH_OPTIONS, "compute_batch")) {
+        return nullptr;
+    }
+
+    vector<Airfield> airfields;
+    PyObject* sequence = PySequence_Fast(airfieldList, "airfields must be a sequence of (x, y, name)");
+    if (!sequence) return nullptr;
+    for (Py_ssize_t k = 0; k < PySequence_Fast_GET_SIZE(sequence); ++k) {
+        Airfield airfield;
+        const char* name;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(sequence, k), "dds", &airfield.x, &airfield.y, &name)) {
+            Py_DECREF(sequence);
+            return nullptr;
+        }
+        airfield.name = name;
+        airfields.push_back(airfield);
+    }
+    Py_DECREF(sequence);
+
+    // run_batch of main.cpp, in memory
+    vector<Solved> solved(airfields.size());
+    vector<string> proj4(airfields.size()), errors(airfields.size());
+    string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        unique_ptr<HgtMosaic> tiles;
+        AscGrid topography;
+        if (isDirectory(path)) tiles.reset(new HgtMosaic(path));
+        else topography.read(path);
+        parallel_for_each(airfields.size(), [&](size_t k, size_t) {
+            const Airfield& airfield = airfields[k];
+            try {
+                const AscGrid* dem = &topography;
+                AscGrid window;
+                if (tiles) {
+                    window = tiles->window(airfield.x, airfield.y, airfield.x, airfield.y);
+                    dem = &window;
+                }
+                float radius = base.finesse * (base.nodataltitude - airfield_elevation(*dem, airfield.x, airfield.y)) + 1;
+                if (radius < cellsize) throw runtime_error("airfield elevation is above the maximum altitude.");
+                proj4[k] = local_tm_proj4(airfield.x, airfield.y);
+                TransverseMercator tm = TransverseMercator::fromProj4(proj4[k]);
+                if (tiles) {
+                    double west, south, east, north;
+                    tm_square_bounds(tm, radius, west, south, east, north);
+                    window = tiles->window(west, south, east, north);
+                }
+                AscGrid local = extract_tm_dem(*dem, tm, radius, cellsize);
+                Params params = base;
+                Matrix M(params, local);
+                solved[k] = solve(M, params, passes != 0);
+            } catch (const exception& e) {
+                errors[k] = e.what();
+            }
+        });
+    } catch (const exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+
+    // {name: result of compute_airfield plus "crs"}, {"error": message} for failures
+    PyObject* results = PyDict_New();
+    if (!results) return nullptr;
+    for (size_t k = 0; k < airfields.size(); ++k) {
+        PyObject* result = errors[k].empty() ? resultDict(solved[k], passes != 0)
+                                             : Py_BuildValue("{s:s}", "error", errors[k].c_str());
+        PyObject* crs = errors[k].empty() ? PyUnicode_FromString(proj4[k].c_str()) : nullptr;
+        bool ok = result && (!errors[k].empty() || (crs && PyDict_SetItemString(result, "crs", crs) == 0)) &&
+                  PyDict_SetItemString(results, airfields[k].name.c_str(), result) == 0;
+        Py_XDECREF(crs);
+        Py_XDECREF(result);
+        if (!ok) {
+            Py_DECREF(results);
+            return nullptr;
+        }
+    }
+    return results;
+}
+
+static PyMethodDef methods[] = {
+    {"read_asc", read_asc, METH_VARARGS,
+     "read_asc(path) -> (header, data): an .asc grid, data a float32 array over the grid read in C++."},
+    {"compute_airfield", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(compute_airfield)),
+     METH_VARARGS | METH_KEYWORDS,
+     "compute_airfield(dem, header, finesse, dist_sol, securite, nodata_altitude, home=(0, 0), passes=False,\n"
+     "                 options=None) -> {'altitude', 'header', 'passes'}\n"
+     "One airfield on a TM DEM (projected.asc): altitude as output_sub.asc, passes a structured\n"
+     "(x, y, weight) array as mountain_passes.csv or None. options: {'--neighbours': 8, ...}, among\n"
+     "--crs, --contours, --contour-height, --simplify, --contour-format, --fixed-point, --neighbours."},
+    {"compute_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(compute_batch)),
+     METH_VARARGS | METH_KEYWORDS,
+     "compute_batch(topography, airfields, finesse, dist_sol, securite, nodata_altitude, cellsize=100,\n"
+     "              passes=False, options=None) -> {name: result}\n"
+     "compute batch in memory: airfields are (lon, lat, name), results those of compute_airfield plus\n"
+     "'crs' (proj4 of the local TM), or {'error': message}. Parallel across airfields. options: only\n"
+     "--fixed-point and --neighbours."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static struct PyModuleDef module = {PyModuleDef_HEAD_INIT, "compute_ext", nullptr, -1, methods,
+                                    nullptr, nullptr, nullptr, nullptr};
+
+PyMODINIT_FUNC PyInit_compute_ext(void) {
+    import_array();
+    return PyModule_Create(&module);
+}
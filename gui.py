@@ -16,6 +16,7 @@ import pandas as pd
 from app_settings import AppSettings
 from utils.cupConvert import convert_coord
 import launch,launch2
+from src.preview import PreviewRun, frame_to_ppm
 
 
 class MountainCirclesGUI:
@@ -313,6 +314,9 @@ class MountainCirclesGUI:
         self.run_button = ttk.Button(
             control_btn_frame, text="Run Processing", command=self.run_processing)
         self.run_button.pack(side=tk.LEFT, padx=5)
+
+        ttk.Button(control_btn_frame, text="Preview Airfield",
+                   command=self.open_preview).pack(side=tk.LEFT, padx=5)
     
         self.open_results_button = ttk.Button(
             control_btn_frame, text="Open Results Folder", command=self.open_results_folder)
@@ -702,6 +706,26 @@ class MountainCirclesGUI:
         except Exception as e:
             raise ValueError(f"Unable to read CRS file: {str(e)}")
 
+    def use_case_params(self):
+        """Parameters dictionary for the Use_case, from the Run tab fields"""
+        return {
+            "data_folder_path": self.data_folder_path.get(),
+            "region": self.region.get(),
+            "use_case_name": self.use_case_name.get(),
+            "airfield_file": self.airfield_path.get(),
+            "calculation_script": self.calc_script.get(),
+            "glide_ratio": int(self.glide_ratio.get()),
+            "ground_clearance": int(self.ground_clearance.get()),
+            "circuit_height": int(self.circuit_height.get()),
+            "max_altitude": int(self.max_altitude.get()),
+            "contour_height": int(self.contour_height.get()),
+            "merged_prefix": "aa",  # Adjust as needed
+            "gurumaps_styles": self.gurumaps_styles.get(),
+            "exportPasses": self.export_passes.get(),
+            "delete_previous_calculation": self.delete_previous_calculation.get(),
+            "clean_temporary_raster_files": self.clean_temporary_raster_files.get(),
+        }
+
     def run_processing(self):
         """Run the main processing with use case parameters.
         
@@ -732,23 +756,7 @@ class MountainCirclesGUI:
                 return
 
             # Prepare parameters dictionary for the Use_case
-            params = {
-                "data_folder_path": self.data_folder_path.get(),
-                "region": self.region.get(),
-                "use_case_name": self.use_case_name.get(),
-                "airfield_file": self.airfield_path.get(),
-                "calculation_script": self.calc_script.get(),
-                "glide_ratio": int(self.glide_ratio.get()),
-                "ground_clearance": int(self.ground_clearance.get()),
-                "circuit_height": int(self.circuit_height.get()),
-                "max_altitude": int(self.max_altitude.get()),
-                "contour_height": int(self.contour_height.get()),
-                "merged_prefix": "aa",  # Adjust as needed
-                "gurumaps_styles": self.gurumaps_styles.get(),
-                "exportPasses": self.export_passes.get(),
-                "delete_previous_calculation": self.delete_previous_calculation.get(),
-                "clean_temporary_raster_files": self.clean_temporary_raster_files.get(),
-            }
+            params = self.use_case_params()
 
             # print("DEBUG: run_processing parameters:", params)
 
@@ -771,6 +779,80 @@ class MountainCirclesGUI:
         except Exception as e:
             messagebox.showerror("Error", str(e))
 
+    def open_preview(self):
+        """Anytime preview of one airfield with the current parameters (src/preview.py):
+        a coarse result within a fraction of a second, refined up to full resolution
+        unless cancelled. Nothing is written to the use case's results."""
+        missing_fields = []
+        if not self.data_folder_path.get().strip():
+            missing_fields.append("MountainCircles Folder")
+        if not self.calc_script.get().strip():
+            missing_fields.append("Calculation Script")
+        if missing_fields:
+            messagebox.showerror("Error", "Missing: " + ", ".join(missing_fields))
+            return
+        try:
+            use_case = Use_case(params=self.use_case_params())
+            airfields = launch2.load_airfields(use_case)
+        except Exception as e:
+            messagebox.showerror("Error", str(e))
+            return
+        if not airfields:
+            messagebox.showerror("Error", "No airfield of the use case is inside the map.")
+            return
+
+        window = tk.Toplevel(self.root)
+        window.title("Preview")
+        by_name = {airfield.name: airfield for airfield in airfields}
+        airfield_name = tk.StringVar(value=airfields[0].name)
+        status = tk.StringVar()
+        preview = {"run": None, "image": None}
+
+        controls = ttk.Frame(window, padding="5")
+        controls.pack(fill="x")
+        ttk.Combobox(controls, values=list(by_name), textvariable=airfield_name,
+                     state="readonly", width=30).pack(side=tk.LEFT, padx=5)
+        ttk.Label(window, textvariable=status).pack(fill="x", padx=5)
+        image_label = ttk.Label(window)
+        image_label.pack(padx=5, pady=5)
+
+        def show(frame, ppm):
+            preview["image"] = tk.PhotoImage(data=ppm)
+            image_label.config(image=preview["image"])
+            level = "full resolution" if frame.factor == 1 else f"{frame.factor}x{frame.factor} blocks"
+            status.set(f"{airfield_name.get()}: {level}, {frame.cellsize:.0f} m cells")
+
+        def start():
+            cancel()
+            status.set(f"{airfield_name.get()}: computing...")
+
+            # frames of a cancelled run still in the pipe are dropped
+            def on_frame(frame):
+                ppm = frame_to_ppm(frame, 500, 500)
+                self.root.after(0, lambda: preview["run"] is run and show(frame, ppm))
+
+            def on_done(error):
+                if error:
+                    self.root.after(0, lambda: status.set(f"Preview failed: {error}"))
+
+            run = PreviewRun(use_case, by_name[airfield_name.get()], on_frame, on_log=print, on_done=on_done)
+            preview["run"] = run
+            run.start()
+
+        def cancel():
+            if preview["run"]:
+                preview["run"].cancel()
+                preview["run"] = None
+
+        def close():
+            cancel()
+            window.destroy()
+
+        ttk.Button(controls, text="Start", command=start).pack(side=tk.LEFT, padx=5)
+        ttk.Button(controls, text="Cancel", command=cancel).pack(side=tk.LEFT, padx=5)
+        window.protocol("WM_DELETE_WINDOW", close)
+        start()
+
     def process_data(self, config_path):
         """Run the main processing function with stdout/stderr redirected,
         and poll the output queue for messages from worker processes."""
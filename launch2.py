@@ -1,110 +1,95 @@
 import os
 import sys
-import multiprocessing
 import shutil
 import subprocess
 from src.shortcuts import normJoin
 from src.airfields import Airfields4326
-from src.postprocess import postProcess2
-from src.raster import merge_output_rasters2
+from src.postprocess import postProcessNative
+from src.mosaic import compute_pending, merge_incremental
 from pathlib import Path
 from src.logging import log_output
 import time
 from src.use_case_settings import Use_case
-from src.warp import main as warp
-
-from utils import process_sectors
-import src.extract_project_tm
-
-
-def make_individuals(airfield, config, output_queue=None):
-
-    # if not config.isInside(airfield.x, airfield.y):
-    #     log_output(
-    #         f'{airfield.name} is outside the map, discarding...', output_queue)
-    #     return
-    # else:
-    log_output(f"launching {airfield.name}", output_queue)
-    # start_time = time.time()
-
+from src.warp import main_native as warp
+from src.pipeline import Stage, run_pipeline
+
+from utils import process_passes, process_sectors, vector_tiles
+
+
+def make_all_individuals(airfields, config, output_queue=None):
+    """
+    TM extraction and calculation of every airfield in one call of the compute binary
+    ("compute batch"), parallel across airfields, instead of writing each airfield's
+    projected.asc with src.extract_project_tm and running the binary on it.
+    Results are shared by every use case and region through the content-addressed cache
+    in data_folder/cache/results.
+    """
+    for _ in stream_all_individuals(airfields, config, output_queue):
+        pass
+
+
+def stream_all_individuals(airfields, config, output_queue=None, folder=None, options=()):
+    """
+    make_all_individuals, yielding each airfield as soon as the binary reports it finished
+    ("Finished <name>"), while the others are still being computed. Airfields that failed
+    are not yielded; when the binary exits with an error (an airfield failed, or it could
+    not start on them) RuntimeError is raised after the last airfield it finished. folder
+    replaces the calculation folder and options are added to the command
+    (utils/shards.py: --shard k/n into a bundle folder).
+    """
+    folder = folder or config.calculation_folder_path
+    airfields_file = normJoin(folder, "airfields.csv")
+    with open(airfields_file, "w", encoding="utf-8") as f:
+        f.write("x,y,name\n")
+        for airfield in airfields:
+            f.write(f"{airfield.x},{airfield.y},{airfield.name}\n")
+    cache_folder = normJoin(config.data_folder_path, "cache", "results")
+    os.makedirs(cache_folder, exist_ok=True)
+
+    command = [
+        config.calculation_script_path, "batch",
+        config.topography_file_path, airfields_file,
+        str(config.glide_ratio), str(config.ground_clearance), str(config.circuit_height),
+        str(config.max_altitude), folder, str(config.exportPasses).lower(),
+        "--contours", f"{{name}}_{config.calculation_name_short}_noAirfields.geojson",
+        "--contour-height", str(config.contour_height),
+        "--simplify", "0.5",
+        "--cache", cache_folder,
+        "--threads", str(config.pipeline["compute"]),
+        "--costs", normJoin(config.data_folder_path, "cache", "costs.txt"),
+        *options
+    ]
+    by_name = {airfield.name: airfield for airfield in airfields}
+    # stderr into the same pipe, so that an unread pipe cannot block the binary
+    process = subprocess.Popen(command, text=True, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    finished = 0
     try:
-        # Create folder for this airfield
-        airfield_folder = normJoin(config.calculation_folder_path, airfield.name)
-        # os.makedirs(airfield_folder, exist_ok=True)
-
-        # Check if the output file already exists, if so, skip processing
-        ASCfile = normJoin(airfield_folder, 'local.asc')
-        # log_output(f"ascII file : {ASCfile}", output_queue)
-        if os.path.exists(ASCfile):
-            log_output(f"Output file already exists for {airfield.name}, skipping this airfield.", output_queue)
-            # log_output(f"Checking ASCfile path: {ASCfile}", output_queue)
-            return
-
-        # Ensure the computation executable exists
-        if not os.path.isfile(config.calculation_script_path):
-            raise FileNotFoundError(
-                f"The calculation script/binary does not exist at {config.calculation_script_path}")
-
-        # Call the C++ function
-        command = [
-            config.calculation_script_path,
-            str(0), str(0),
-            str(config.glide_ratio), str(
-                config.ground_clearance), str(config.circuit_height),
-            str(config.max_altitude), str(
-                airfield_folder), normJoin(airfield_folder, "projected.asc"), str(config.exportPasses).lower()
-        ]
-        # print("DEBUG: Running command:", command)
-        result = subprocess.run(command, check=True,
-                                text=True, capture_output=True)
-
-        # Check for errors or warnings in the output
-        if result.stdout:
-            log_output(
-                f"Output for {airfield.name}: {result.stdout}", output_queue)
-        if result.stderr:
-            log_output(
-                f"Warnings/Errors for {airfield.name}: {result.stderr}", output_queue)
-
-    except subprocess.CalledProcessError as e:
-        log_output(
-            f"An error occurred while executing external process for {airfield.name}: {e}", output_queue)
-        log_output(f"Process output: {e.output}", output_queue)
-        log_output(f"Process errors: {e.stderr}", output_queue)
-        return  # Exit if there was an error with calculation_script_path
-
-    except FileNotFoundError as e:
-        log_output(
-            f"File not found error during processing for {airfield.name}: {e}", output_queue)
-        return  # Exit if an expected file was not found
+        for line in process.stdout:
+            line = line.rstrip("\n")
+            if line.startswith("Finished ") and line[len("Finished "):] in by_name:
+                finished += 1
+                yield by_name[line[len("Finished "):]]
+            elif line:
+                log_output(line, output_queue)
+        if process.wait() != 0:
+            raise RuntimeError(f"compute batch exited with {process.returncode} after {finished} finished "
+                               f"airfields, see the errors above")
+    finally:
+        process.stdout.close()
+        process.wait()
+        os.remove(airfields_file)
 
-    except IOError as e:
-        log_output(
-            f"I/O error occurred for {airfield.name}: {e}", output_queue)
-        return  # Handle general I/O errors
-
-    except Exception as e:
-        log_output(
-            f"An unexpected error occurred while processing {airfield.name}: {e}", output_queue)
-        return  # Catch-all for any other exceptions
-
-    # end_time = time.time()
-    # log_output(f"Time taken for {airfield.name}: {end_time - start_time:.2f} seconds", output_queue)
-    # start_time = time.time()
-    
 # make a war function for an individual airfield with output_queue
-def warp_airfield(airfield,config,output_queue):
+def warp_airfield(airfield,config,output_queue,folder=None):
+    """Raises when the warp fails: the pipeline drops the airfield and counts it as failed"""
     start_time = time.time()
-    airfield_folder = normJoin(config.calculation_folder_path, airfield.name)
-    
-    try:
-        warp(airfield_folder, output_queue=output_queue)
-        end_time = time.time()
-        log_output(f"Time taken for warp for {airfield.name}: {end_time - start_time:.2f} seconds", output_queue)
-        start_time = time.time()
-    except Exception as e:
-        log_output(
-            f"Error during warp for {airfield.name}: {e}", output_queue)
+    airfield_folder = normJoin(folder or config.calculation_folder_path, airfield.name)
+
+    # local4326.asc is only needed for contours, which compute now writes directly
+    warp(config.calculation_script_path, airfield_folder, output_queue=output_queue, files_to_convert=[("output_sub.asc", "output_sub4326.asc")])
+    end_time = time.time()
+    log_output(f"Time taken for warp for {airfield.name}: {end_time - start_time:.2f} seconds", output_queue)
+    return airfield
 
 # make a postprocess function for an individual airfield with output_queue
 def postprocess_airfield(airfield,config,output_queue):
@@ -112,13 +97,13 @@ def postprocess_airfield(airfield,config,output_queue):
     airfield_folder = normJoin(config.calculation_folder_path, airfield.name)
     
     try:
-        ASCfile2 = normJoin(airfield_folder, 'local4326.asc')
         naming = f"{airfield.name}_{config.calculation_name_short}"
-        postProcess2(str(airfield_folder), Path(config.calculation_folder_path),
-                    config, str(ASCfile2), naming, output_queue)
+        postProcessNative(str(airfield_folder), Path(config.calculation_folder_path),
+                    config, naming, output_queue)
     except Exception as e:
         log_output(
             f"Error during post-processing for {airfield.name}: {e}", output_queue)
+    return airfield
     # end_time = time.time()
     # log_output(f"Time taken for post-processing for {airfield.name}: {end_time - start_time:.2f} seconds", output_queue)
     # start_time = time.time()
@@ -143,12 +128,16 @@ def clean(config):
         #move the folder_path to the destination_path and create the path if it doesn't exist
         os.makedirs(destination_path, exist_ok=True)
         shutil.move(file_path, normJoin(destination_path, f"{folder_name}.csv"))
+        # the passes are in the airfield's own TM CRS, kept for the passes vector tiles
+        crs_path = normJoin(os.path.dirname(file_path), "crs.txt")
+        if os.path.exists(crs_path):
+            shutil.copy2(crs_path, normJoin(destination_path, f"{folder_name}_crs.txt"))
 
     # Iterate over files in the calculation folder
     passes_folder = normJoin(calc_folder_path, "individual passes")
     for folder in folders:
-        #skip item "individual passes"
-        if folder == "individual passes":
+        #skip item "individual passes" and the persisted mosaic
+        if folder == "individual passes" or folder == "mosaic":
             continue
         folder_path = normJoin(calc_folder_path, folder)
         for file in os.listdir(folder_path):
@@ -160,7 +149,7 @@ def clean(config):
 
     #remove all folders in the calculation folder except for the passes folder
     for folder in folders:
-        if folder != "individual passes" and folder!= "sector_raster":
+        if folder != "individual passes" and folder!= "sector_raster" and folder != "mosaic":
             print(f"removing {normJoin(calc_folder_path, folder)}")
             shutil.rmtree(normJoin(calc_folder_path, folder))
 
@@ -170,80 +159,121 @@ def clean(config):
             os.remove(normJoin(config.calculation_folder_path, file))
 
 
-def main(use_case_file, output_queue=None):
-    # print("DEBUG: Entering launch.main with use_case_file:", use_case_file)
-    start_time = time.time()
-
-    # Load the new use case settings from the YAML file.
-    use_case = Use_case(use_case_file=use_case_file)
-    # print("DEBUG: Use_case loaded:")
-    print(f"  calculation_script: {use_case.calculation_script}")
-    print(f"  calculation_folder_path: {use_case.calculation_folder_path}")
-    print(f"  airfield_file: {use_case.airfield_file_path}")
-    print(f"  topography_file: {use_case.topography_file_path}")
-    print(f"  merged_prefix: {use_case.merged_prefix}")
-    print(f"  exportPasses: {use_case.exportPasses}")
-
-    if use_case.delete_previous_calculation:
-        use_case.clean()
-
-    # Load the airfields file using the new use_case settings
+def load_airfields(use_case):
+    """The airfields of the use case inside the map, in file order"""
     airfields = Airfields4326(use_case).list_of_airfields
-    # print([(airfield.name, airfield.x, airfield.y) for airfield in airfields])
     print("Number of airfields loaded:", len(airfields))
 
-
     #discard airfields that are outside the map
     airfields = [airfield for airfield in airfields if use_case.isInside(airfield.x, airfield.y)]
     print("Number of airfields inside the map:", len(airfields))
+    return airfields
 
-    # create folders for each airfield
-    for airfield in airfields:
-        os.makedirs(normJoin(use_case.calculation_folder_path, airfield.name), exist_ok=True)
 
-    src.extract_project_tm.main(use_case, airfields)
+def process_airfields(source, use_case, output_queue=None):
+    """
+    Warp to EPSG:4326 and GeoJSON of each airfield of source as soon as it comes, the
+    stages overlapping (src/pipeline.py). An airfield whose warp fails is left out, and
+    RuntimeError is raised once the others are through, as for compute failures.
+    """
+    workers = use_case.pipeline
+    failed = []
+
+    def on_error(stage, airfield, e):
+        log_output(f"Error during {stage} for {airfield.name}: {e}", output_queue)
+        failed.append(airfield.name)
+
+    run_pipeline(source, [
+        Stage("warp", lambda airfield: warp_airfield(airfield, use_case, output_queue), workers["warp"]),
+        Stage("postprocess", lambda airfield: postprocess_airfield(airfield, use_case, output_queue), workers["postprocess"]),
+    ], queue_size=workers["queue_size"], on_error=on_error)
+    if failed:
+        raise RuntimeError(f"{len(failed)} airfields could not be processed: {', '.join(sorted(failed))}")
 
-    # Use multiprocessing to make individual files for each airfield
-    with multiprocessing.Pool() as pool:
-        pool.starmap(make_individuals, [
-            (airfield, use_case, output_queue) for airfield in airfields
-        ])
-    
-    # Use multiprocessing to warp each airfield with half the number of cores
-    with multiprocessing.Pool(processes=multiprocessing.cpu_count()//2) as pool:
-        pool.starmap(warp_airfield, [
-            (airfield, use_case, output_queue) for airfield in airfields
-        ]) 
-    
-    # Use multiprocessing to post-process each airfield
-    with multiprocessing.Pool() as pool:
-        pool.starmap(postprocess_airfield, [
-            (airfield, use_case, output_queue) for airfield in airfields
-        ])
 
+def finish(use_case, mosaic, airfields, pending, removed, output_queue=None):
+    """Merged raster, sectors and vector tiles once the pending airfields are processed"""
     print("finished processing individual airfields")
     # Build the filenames using the new use_case properties.
     sectors_file = f'{use_case.merged_prefix}_{use_case.calculation_name}_sectors.asc'
     merged_file = f'{use_case.merged_prefix}_{use_case.calculation_name}.asc'
     print(sectors_file)
     print(merged_file)
-    # # Merge the output rasters.
-    merge_output_rasters2(use_case, merged_file, sectors_file, output_queue)
+    # # Merge the output rasters: only the new airfields' windows are reduced into the mosaic
+    merge_incremental(mosaic, use_case, airfields, pending, removed, output_queue)
     
     # # Process sectors (make sure process_sectors is updated if it depends on config)
-    process_sectors.main2(use_case, 4000, 7, None)
+    process_sectors.main_native(use_case, 0.03, 7, None, output_queue)
     print("finished processing sectors")
 
+    # Vector tiles of the merged contours, sectors and passes, lighter than the GeoJSON files on phones
+    if use_case.vector_tiles["enabled"]:
+        layers = {"contours": use_case.merged_output_filepath, "sectors": use_case.sectors1_filepath}
+        if use_case.exportPasses:
+            count = process_passes.merge_airfield_passes(use_case.calculation_folder_path,
+                                                         [airfield.name for airfield in airfields],
+                                                         use_case.passes_filepath)
+            log_output(f"{count} passes merged into {use_case.passes_filepath}", output_queue)
+            layers["passes"] = use_case.passes_filepath
+        vector_tiles.main(normJoin(use_case.calculation_folder_path, f"{use_case.merged_output_name}.mbtiles"),
+                          layers, use_case.vector_tiles["minzoom"], use_case.vector_tiles["maxzoom"],
+                          output_queue=output_queue)
+
     # # Clean temporary files if requested
     if use_case.clean_temporary_raster_files:
         print("cleaning temporary files")
         clean(use_case)
         print("cleaned temporary files")
 
+
+def main(use_case_file, output_queue=None):
+    # print("DEBUG: Entering launch.main with use_case_file:", use_case_file)
+    start_time = time.time()
+
+    # Load the new use case settings from the YAML file.
+    use_case = Use_case(use_case_file=use_case_file)
+    # print("DEBUG: Use_case loaded:")
+    print(f"  calculation_script: {use_case.calculation_script}")
+    print(f"  calculation_folder_path: {use_case.calculation_folder_path}")
+    print(f"  airfield_file: {use_case.airfield_file_path}")
+    print(f"  topography_file: {use_case.topography_file_path}")
+    print(f"  merged_prefix: {use_case.merged_prefix}")
+    print(f"  exportPasses: {use_case.exportPasses}")
+
+    if use_case.delete_previous_calculation:
+        use_case.clean()
+
+    # Load the airfields file using the new use_case settings
+    airfields = load_airfields(use_case)
+
+    # Airfields already in the persisted mosaic (same parameters, DEM and coordinates) are
+    # not computed again; removed ones are taken out of it here
+    mosaic, pending, removed = compute_pending(use_case, airfields, output_queue)
+
+    # create folders for each airfield
+    for airfield in pending:
+        os.makedirs(normJoin(use_case.calculation_folder_path, airfield.name), exist_ok=True)
+
+    # Local TM topography and calculation of each airfield (threads across airfields), then
+    # its warp to EPSG:4326 and its GeoJSON as soon as it is computed, while the next ones
+    # are: the stages overlap instead of running one after the other over all airfields
+    failure = None
+    if pending:
+        try:
+            process_airfields(stream_all_individuals(pending, use_case, output_queue), use_case, output_queue)
+        except RuntimeError as e:
+            # the airfields that finished are merged all the same, the failed ones stay pending
+            log_output(str(e), output_queue)
+            failure = e
+
+    finish(use_case, mosaic, airfields, pending, removed, output_queue)
+
     end_time = time.time()
     elapsed_time = end_time - start_time
     print(f"Finished! did it in: {elapsed_time:.2f} seconds")
     time.sleep(0.2)
+    if failure:
+        raise RuntimeError(f"some airfields failed and were left out of the map: {failure}")
 
 
 if __name__ == "__main__":
@@ -258,4 +288,8 @@ if __name__ == "__main__":
         print(f"Error: Configuration file {config_file} not found.")
         sys.exit(1)
 
-    main(config_file)
+    try:
+        main(config_file)
+    except RuntimeError as e:
+        print(f"Error: {e}")
+        sys.exit(1)
@@ -0,0 +1,308 @@
+"""
+Persisted merge of the per-airfield EPSG:4326 rasters, so that a change of the airfield list
+only touches the cells it concerns instead of merging every output_sub4326.asc again.
+
+calculation_folder/mosaic holds
+  manifest.json   hash of the parameters and of the DEM content, the merged grid lattice and,
+                  per airfield (keyed by name and coordinates), its owner id and window
+  mosaic.npz      minimum altitude and owner id (-1 = none) of every merged cell
+  <key>.npz       the airfield's own output_sub4326.asc values, to re-resolve removals
+
+Adding an airfield min-reduces only its window; removing one resets the cells it owned and
+re-resolves them from the stored layers of the airfields overlapping them. The merged and
+sectors rasters are the same as merge_output_rasters2, sector values being the owner ids.
+"""
+
+import os
+import json
+import shutil
+import hashlib
+import subprocess
+import numpy as np
+from src.shortcuts import normJoin
+from src.raster import write_asc
+from src.postprocess import postProcess2, refresh_airfield_points
+from src.logging import log_output
+
+FORMAT = 1
+OWNER_NONE = -1
+
+
+def airfield_key(airfield):
+    return hashlib.sha1(f"{airfield.name}|{airfield.x!r}|{airfield.y!r}".encode("utf-8")).hexdigest()[:16]
+
+
+def _file_sha256(path, cache):
+    """sha256 of a file, reused from the previous manifest while its size and mtime are unchanged."""
+    stat = os.stat(path)
+    cached = cache.get(path)
+    if cached and cached["size"] == stat.st_size and cached["mtime"] == stat.st_mtime:
+        return cached
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 22), b""):
+            digest.update(block)
+    return {"size": stat.st_size, "mtime": stat.st_mtime, "sha256": digest.hexdigest()}
+
+
+def dem_fingerprint(topography_path, cache):
+    """Per-file content hashes of the topography (one .asc, or every tile of an .hgt folder)."""
+    if os.path.isdir(topography_path):
+        paths = sorted(normJoin(topography_path, name) for name in os.listdir(topography_path)
+                       if name.lower().endswith(".hgt"))
+    else:
+        paths = [topography_path]
+    return {path: _file_sha256(path, cache) for path in paths}
+
+
+def propagation_version(calculation_script_path):
+    """Matrix::PROPAGATION_VERSION of the compute binary (compute --version), None when it has none"""
+    try:
+        result = subprocess.run([calculation_script_path, "--version"], capture_output=True, text=True)
+    except OSError:
+        return None
+    return result.stdout.strip() if result.returncode == 0 else None
+
+
+def read_output_raster(path):
+    """Header and values of an output_sub4326.asc"""
+    with open(path, 'r', encoding='utf-8-sig') as f:
+        ncols = int(next(f).split()[1])
+        nrows = int(next(f).split()[1])
+        xllcorner = float(next(f).split()[1])
+        yllcorner = float(next(f).split()[1])
+        cellsize = float(next(f).split()[1])
+        next(f)
+        values = np.fromstring(f.read(), dtype=float, sep=' ')
+    if values.size != ncols * nrows:
+        raise ValueError(f"{path}: expected {ncols * nrows} values, found {values.size}")
+    return values.reshape(nrows, ncols), xllcorner, yllcorner, cellsize
+
+
+class Mosaic:
+    def __init__(self, config, output_queue=None):
+        self.config = config
+        self.output_queue = output_queue
+        self.folder = normJoin(config.calculation_folder_path, "mosaic")
+        self.nodata = float(config.max_altitude)
+        self.manifest_path = normJoin(self.folder, "manifest.json")
+        self.arrays_path = normJoin(self.folder, "mosaic.npz")
+
+        previous = {}
+        if os.path.exists(self.manifest_path):
+            with open(self.manifest_path, 'r') as f:
+                previous = json.load(f)
+        cache = {path: entry for path, entry in previous.get("dem", {}).items()}
+        self.dem = dem_fingerprint(config.topography_file_path, cache)
+        self.parameters = self.parameters_hash()
+
+        if previous.get("parameters") == self.parameters and os.path.exists(self.arrays_path):
+            self.grid = previous["grid"]
+            self.airfields = previous["airfields"]
+            self.next_id = previous["next_id"]
+            arrays = np.load(self.arrays_path)
+            self.altitude = arrays["altitude"]
+            self.owner = arrays["owner"]
+            return
+
+        if previous:
+            # parameters or DEM changed: the stored per-airfield results are stale too
+            log_output("parameters or topography changed, rebuilding the mosaic", output_queue)
+            for entry in previous.get("airfields", {}).values():
+                shutil.rmtree(normJoin(config.calculation_folder_path, entry["name"]), ignore_errors=True)
+        shutil.rmtree(self.folder, ignore_errors=True)
+        os.makedirs(self.folder)
+        self.grid = None
+        self.airfields = {}
+        self.next_id = 0
+        self.altitude = np.zeros((0, 0))
+        self.owner = np.zeros((0, 0), dtype=np.int32)
+
+    def parameters_hash(self):
+        """Every setting the compute and post-processing commands of an airfield depend on, the version of
+        the propagation (a newer binary rebuilds everything) and the DEM"""
+        c = self.config
+        content = json.dumps({
+            "format": FORMAT,
+            "glide_ratio": c.glide_ratio, "ground_clearance": c.ground_clearance,
+            "circuit_height": c.circuit_height, "max_altitude": c.max_altitude,
+            "contour_height": c.contour_height, "exportPasses": bool(c.exportPasses),
+            "gurumaps_styles": bool(c.gurumaps_styles), "calculation_script": c.calculation_script,
+            "propagation_version": propagation_version(c.calculation_script_path),
+            "dem": sorted((os.path.basename(path), entry["sha256"]) for path, entry in self.dem.items())
+        }, sort_keys=True)
+        return hashlib.sha256(content.encode("utf-8")).hexdigest()
+
+    def save(self):
+        np.savez(self.arrays_path, altitude=self.altitude, owner=self.owner)
+        manifest = {"format": FORMAT, "parameters": self.parameters, "dem": self.dem,
+                    "grid": self.grid, "next_id": self.next_id, "airfields": self.airfields}
+        with open(self.manifest_path + ".tmp", 'w') as f:
+            json.dump(manifest, f, indent=1)
+        os.replace(self.manifest_path + ".tmp", self.manifest_path)
+
+    def pending(self, airfields):
+        """Airfields which are not in the mosaic yet and must be computed"""
+        return [airfield for airfield in airfields if airfield_key(airfield) not in self.airfields]
+
+    def remove_missing(self, airfields):
+        """
+        Drops the airfields absent from the list: their folders, GeoJSON and stored layer go, and
+        the cells they owned are re-resolved from the remaining layers. Returns their names.
+        """
+        keep = {airfield_key(airfield) for airfield in airfields}
+        removed = []
+        for key in [key for key in self.airfields if key not in keep]:
+            entry = self.airfields.pop(key)
+            removed.append(entry["name"])
+            log_output(f"removing {entry['name']} from the mosaic", self.output_queue)
+            self.resolve_owned_cells(entry)
+            os.remove(normJoin(self.folder, f"{key}.npz"))
+            shutil.rmtree(normJoin(self.config.calculation_folder_path, entry["name"]), ignore_errors=True)
+            naming = f"{entry['name']}_{self.config.calculation_name_short}"
+            for extension in (".geojson", ".mapcss"):
+                path = normJoin(self.config.calculation_folder_path, naming + extension)
+                if os.path.exists(path):
+                    os.remove(path)
+        return removed
+
+    def resolve_owned_cells(self, entry):
+        r0, c0 = entry["row"], entry["col"]
+        r1, c1 = r0 + entry["nrows"], c0 + entry["ncols"]
+        owned = self.owner[r0:r1, c0:c1] == entry["id"]
+        if not owned.any():
+            return
+        altitude = self.altitude[r0:r1, c0:c1]
+        owner = self.owner[r0:r1, c0:c1]
+        altitude[owned] = self.nodata
+        owner[owned] = OWNER_NONE
+        # layers in id order, as they were first merged, so that ties keep the same owner
+        for key, other in sorted(self.airfields.items(), key=lambda item: item[1]["id"]):
+            top, left = max(r0, other["row"]), max(c0, other["col"])
+            bottom = min(r1, other["row"] + other["nrows"])
+            right = min(c1, other["col"] + other["ncols"])
+            if top >= bottom or left >= right:
+                continue
+            layer = np.load(normJoin(self.folder, f"{key}.npz"))["values"]
+            values = layer[top - other["row"]:bottom - other["row"], left - other["col"]:right - other["col"]]
+            window = (slice(top - r0, bottom - r0), slice(left - c0, right - c0))
+            update = owned[window] & (values != self.nodata) & (values < altitude[window])
+            altitude[window][update] = values[update]
+            owner[window][update] = other["id"]
+
+    def cover(self, headers):
+        """Grows the grid, on its lattice, to contain the given (xllcorner, yllcorner, cellsize, nrows, ncols)"""
+        cellsize = headers[0][2]
+        min_x = min(x + cellsize / 2 for x, _, _, _, _ in headers)
+        max_x = max(x + (ncols - 0.5) * cellsize for x, _, _, _, ncols in headers)
+        min_y = min(y + cellsize / 2 for _, y, _, _, _ in headers)
+        max_y = max(y + (nrows - 0.5) * cellsize for _, y, _, nrows, _ in headers)
+        if self.grid is None:
+            # anchored like merge_output_rasters2: minimum x and maximum y cell centres
+            self.grid = {"x0": min_x, "y0": max_y, "cellsize": cellsize, "nrows": 0, "ncols": 0}
+        grid = self.grid
+        if abs(cellsize - grid["cellsize"]) > 1e-9 * cellsize:
+            raise ValueError(f"cellsize {cellsize} differs from the mosaic's {grid['cellsize']}")
+
+        left = max(0, int(round((grid["x0"] - min_x) / cellsize)))
+        top = max(0, int(round((max_y - grid["y0"]) / cellsize)))
+        right = max(0, int(round((max_x - grid["x0"]) / cellsize)) + 1 - grid["ncols"])
+        bottom = max(0, int(round((grid["y0"] - min_y) / cellsize)) + 1 - grid["nrows"])
+        if not (left or top or right or bottom):
+            return
+        self.altitude = np.pad(self.altitude, ((top, bottom), (left, right)), constant_values=self.nodata)
+        self.owner = np.pad(self.owner, ((top, bottom), (left, right)), constant_values=OWNER_NONE)
+        grid["x0"] -= left * cellsize
+        grid["y0"] += top * cellsize
+        grid["nrows"], grid["ncols"] = self.altitude.shape
+        for entry in self.airfields.values():
+            entry["row"] += top
+            entry["col"] += left
+
+    def add(self, airfields):
+        """Min-reduces the output_sub4326.asc of each airfield into its own window of the mosaic"""
+        layers = []
+        for airfield in airfields:
+            path = normJoin(self.config.calculation_folder_path, airfield.name, "output_sub4326.asc")
+            if not os.path.exists(path):
+                log_output(f"no output_sub4326.asc for {airfield.name}, not added to the mosaic", self.output_queue)
+                continue
+            layers.append((airfield, read_output_raster(path)))
+        if not layers:
+            return []
+        self.cover([(x, y, cellsize, values.shape[0], values.shape[1])
+                    for _, (values, x, y, cellsize) in layers])
+
+        grid = self.grid
+        for airfield, (values, xllcorner, yllcorner, cellsize) in layers:
+            nrows, ncols = values.shape
+            col = int(round((xllcorner + cellsize / 2 - grid["x0"]) / cellsize))
+            row = int(round((grid["y0"] - (yllcorner + (nrows - 0.5) * cellsize)) / cellsize))
+            key = airfield_key(airfield)
+            entry = {"name": airfield.name, "x": airfield.x, "y": airfield.y, "id": self.next_id,
+                     "row": row, "col": col, "nrows": nrows, "ncols": ncols}
+            self.next_id += 1
+
+            altitude = self.altitude[row:row + nrows, col:col + ncols]
+            owner = self.owner[row:row + nrows, col:col + ncols]
+            update = (values != self.nodata) & (values < altitude)
+            altitude[update] = values[update]
+            owner[update] = entry["id"]
+            np.savez_compressed(normJoin(self.folder, f"{key}.npz"), values=values)
+            self.airfields[key] = entry
+            log_output(f"added {airfield.name} to the mosaic", self.output_queue)
+        return [airfield for airfield, _ in layers]
+
+    def write_rasters(self, output_path, sectors_path):
+        """The merged and sectors rasters of merge_output_rasters2"""
+        grid = self.grid
+        cellsize = grid["cellsize"]
+        ground = self.altitude == 0
+        aligned = self.altitude.copy()
+        aligned[ground] = self.nodata
+        sectors = np.where((self.owner != OWNER_NONE) & ~ground, self.owner, self.nodata).astype(float)
+        xllcorner = grid["x0"] - cellsize / 2
+        yllcorner = grid["y0"] - (grid["nrows"] - 0.5) * cellsize
+        log_output(f"writing final raster to {output_path}", self.output_queue)
+        write_asc(aligned, output_path, grid["ncols"], grid["nrows"], xllcorner, yllcorner, cellsize, self.nodata)
+        log_output(f"writing sector raster to {sectors_path}", self.output_queue)
+        write_asc(sectors, sectors_path, grid["ncols"], grid["nrows"], xllcorner, yllcorner, cellsize, self.nodata)
+
+
+def compute_pending(config, airfields, output_queue=None):
+    """
+    Opens the mosaic, drops the airfields no longer in the list and returns it with the
+    airfields still to compute. Done before computing, an airfield moved under the same name
+    gets its folder cleared first.
+    """
+    mosaic = Mosaic(config, output_queue)
+    removed = mosaic.remove_missing(airfields)
+    pending = mosaic.pending(airfields)
+    log_output(f"mosaic: {len(airfields) - len(pending)} airfields up to date, "
+               f"{len(pending)} to compute, {len(removed)} removed", output_queue)
+    mosaic.save()
+    return mosaic, pending, bool(removed)
+
+
+def merge_incremental(mosaic, config, airfields, pending, removed, output_queue=None):
+    """
+    Adds the freshly computed airfields to the mosaic, writes the merged and sectors rasters
+    and their contours. When the list changed, the airfield points of the per-airfield GeoJSON
+    files kept from earlier runs are refreshed too.
+    """
+    added = mosaic.add(pending)
+    mosaic.save()
+    if mosaic.grid is None:
+        log_output("No output_sub4326.asc files found to merge.", output_queue)
+        return
+    if added or removed:
+        pending_names = {airfield.name for airfield in pending}
+        for airfield in airfields:
+            if airfield.name not in pending_names:
+                refresh_airfield_points(config.calculation_folder_path, config,
+                                        f"{airfield.name}_{config.calculation_name_short}", output_queue)
+
+    output_path = config.merged_output_raster_path
+    mosaic.write_rasters(output_path, config.sectors_filepath)
+    log_output("Post processing final raster...", output_queue)
+    postProcess2(config.calculation_folder_path, config.calculation_folder_path, config, output_path, config.merged_output_name)
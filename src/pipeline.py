@@ -0,0 +1,84 @@
+"""
+Overlapped stages for the per-airfield work of launch2.py: every item (an airfield) goes
+through the stages in order, each stage as soon as the previous one is done with it, so
+that the warp of one airfield runs while others are still being computed.
+
+Each stage has its own worker threads and reads from a bounded queue: a slow stage makes
+the one before it wait instead of piling up items. The stages are expected to spend their
+time in subprocesses or in I/O, so threads are enough to overlap them.
+"""
+
+import queue
+import threading
+
+_END = object()
+
+
+class Stage:
+    def __init__(self, name, function, workers=1):
+        """
+        function(item) returns the item handed to the next stage, or None to drop it there.
+        """
+        self.name = name
+        self.function = function
+        self.workers = max(1, int(workers))
+
+
+def run_pipeline(source, stages, queue_size=8, on_error=None):
+    """
+    Feeds the items of `source` (any iterable, it may block between items, e.g. while
+    reading a subprocess's output) through `stages`, and returns what the last stage
+    returned, in completion order.
+
+    An exception in a stage drops the item, after on_error(stage name, item, exception)
+    when given; the other items go on.
+    """
+    queues = [queue.Queue(maxsize=max(1, queue_size)) for _ in stages]
+    results = []
+    results_lock = threading.Lock()
+
+    def worker(k, remaining):
+        stage = stages[k]
+        while True:
+            item = queues[k].get()
+            if item is _END:
+                break
+            try:
+                item = stage.function(item)
+            except Exception as e:
+                if on_error:
+                    on_error(stage.name, item, e)
+                continue
+            if item is None:
+                continue
+            if k + 1 < len(stages):
+                queues[k + 1].put(item)
+            else:
+                with results_lock:
+                    results.append(item)
+        # the last worker of a stage to stop stops the next stage
+        with remaining["lock"]:
+            remaining["count"] -= 1
+            last = remaining["count"] == 0
+        if last and k + 1 < len(stages):
+            for _ in range(stages[k + 1].workers):
+                queues[k + 1].put(_END)
+
+    threads = []
+    for k, stage in enumerate(stages):
+        remaining = {"count": stage.workers, "lock": threading.Lock()}
+        for w in range(stage.workers):
+            thread = threading.Thread(target=worker, args=(k, remaining),
+                                      name=f"{stage.name}-{w}", daemon=True)
+            thread.start()
+            threads.append(thread)
+
+    try:
+        for item in source:
+            queues[0].put(item)
+    finally:
+        for _ in range(stages[0].workers):
+            queues[0].put(_END)
+        for thread in threads:
+            thread.join()
+    return results
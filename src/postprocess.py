@@ -264,6 +264,37 @@ def merge_geojson_files(inThisFolder, toThatFolder, config, contourFileName, out
         log_output(f"An unexpected error occurred: {e}", output_queue)
 
 
+def refresh_airfield_points(toThatFolder, config, contourFileName, output_queue=None):
+    """
+    Replaces the airfield points of an already merged {contourFileName}.geojson by the current
+    airfield list, keeping its contours, when airfields were added or removed since it was made.
+    """
+    try:
+        geojson_airfields_path = normJoin(config.result_folder, "airfields", f"{config.use_case_name}.geojson")
+        merged_geojson_path = normJoin(toThatFolder, f'{contourFileName}.geojson')
+        if not os.path.exists(merged_geojson_path):
+            return
+
+        with open(geojson_airfields_path, 'r') as f:
+            airfield_features = json.load(f).get("features", [])
+        with open(merged_geojson_path, 'r') as f:
+            merged_geojson = json.load(f)
+
+        for feature in airfield_features:
+            if feature.get("geometry", {}).get("type") == "Point":
+                name = feature.get("properties", {}).get("name", "unknown")
+                feature["properties"]["filename"] = f"{name}_{config.calculation_name_short}.geojson"
+        contours = [feature for feature in merged_geojson.get("features", [])
+                    if feature.get("geometry", {}).get("type") != "Point"]
+        merged_geojson["features"] = airfield_features + contours
+
+        with open(merged_geojson_path, 'w') as f:
+            json.dump(merged_geojson, f, separators=(',', ':'))
+
+    except Exception as e:
+        log_output(f"{contourFileName}: could not refresh airfields: {e}", output_queue)
+
+
 def copyMapCss(toThatFolder, config, contourFileName, extension, output_queue=None):
     try:
         # copy mapcss for gurumaps export
@@ -291,3 +322,12 @@ def postProcess2(inThisFolder, toThatFolder, config, ASCfilePath, contourFileNam
     merge_geojson_files(inThisFolder, toThatFolder, config, contourFileName, output_queue)
     if (config.gurumaps_styles):
         copyMapCss(toThatFolder, config, contourFileName, "", output_queue)
+
+def postProcessNative(inThisFolder, toThatFolder, config, contourFileName, output_queue=None):
+    """
+    Same as postProcess2 when the compute binary already wrote
+    {contourFileName}_noAirfields.geojson in EPSG:4326 (--contours option).
+    """
+    merge_geojson_files(inThisFolder, toThatFolder, config, contourFileName, output_queue)
+    if (config.gurumaps_styles):
+        copyMapCss(toThatFolder, config, contourFileName, "", output_queue)
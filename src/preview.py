@@ -0,0 +1,160 @@
+"""
+Anytime preview of one airfield: the compute binary (batch mode, --preview -) first sends
+the result solved on 8x8 blocks, within a fraction of the full run, then on 4x4 and 2x2
+blocks, then at full resolution, each as a binary frame on its stdout (cpp/io/PreviewFrames.h).
+Frames are handed over as they arrive; cancelling kills the binary at whatever level it
+has reached. The full resolution outputs go to a temporary folder, removed at the end.
+"""
+
+import os
+import shutil
+import struct
+import subprocess
+import tempfile
+import threading
+
+import numpy as np
+
+from src.shortcuts import normJoin
+
+FRAME_MAGIC = b"MPV1"
+FRAME_HEADER = struct.Struct("=4sIIIIdddf")     # native byte order, no padding, as written
+
+
+class Frame:
+    def __init__(self, factor, final, values, xllcorner, yllcorner, cellsize, nodata):
+        """values: float32 array of nrows x ncols, row 0 north; nodata where not reachable"""
+        self.factor = factor
+        self.final = final
+        self.values = values
+        self.xllcorner = xllcorner
+        self.yllcorner = yllcorner
+        self.cellsize = cellsize
+        self.nodata = nodata
+
+
+def _read_exactly(stream, size):
+    data = b""
+    while len(data) < size:
+        chunk = stream.read(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
+def read_frames(stream):
+    """Yields the frames of a binary stream until it ends; a truncated frame ends it too"""
+    while True:
+        header = _read_exactly(stream, FRAME_HEADER.size)
+        if header is None:
+            return
+        magic, factor, final, ncols, nrows, xllcorner, yllcorner, cellsize, nodata = FRAME_HEADER.unpack(header)
+        if magic != FRAME_MAGIC:
+            raise ValueError(f"not a preview frame: {magic!r}")
+        data = _read_exactly(stream, 4 * ncols * nrows)
+        if data is None:
+            return
+        values = np.frombuffer(data, dtype=np.float32).reshape(nrows, ncols)
+        yield Frame(factor, bool(final), values, xllcorner, yllcorner, cellsize, nodata)
+
+
+class PreviewRun:
+    def __init__(self, use_case, airfield, on_frame, on_log=None, on_done=None, levels=(8, 4, 2)):
+        """
+        on_frame(frame) is called for each frame, on_log(line) for the binary's text output
+        and on_done(error or None) at the end, all from the reading thread.
+        """
+        self.use_case = use_case
+        self.airfield = airfield
+        self.on_frame = on_frame
+        self.on_log = on_log or (lambda line: None)
+        self.on_done = on_done or (lambda error: None)
+        self.levels = levels
+        self.process = None
+        self.cancelled = False
+
+    def command(self, folder, airfields_file):
+        use_case = self.use_case
+        return [
+            use_case.calculation_script_path, "batch",
+            use_case.topography_file_path, airfields_file,
+            str(use_case.glide_ratio), str(use_case.ground_clearance), str(use_case.circuit_height),
+            str(use_case.max_altitude), folder, "false",
+            "--preview", "-",
+            "--preview-levels", ",".join(str(level) for level in self.levels) or "none",
+        ]
+
+    def start(self):
+        thread = threading.Thread(target=self._run, name=f"preview-{self.airfield.name}", daemon=True)
+        thread.start()
+        return thread
+
+    def cancel(self):
+        self.cancelled = True
+        if self.process and self.process.poll() is None:
+            self.process.kill()
+
+    def _run(self):
+        folder = tempfile.mkdtemp(prefix="preview_")
+        error = None
+        try:
+            os.makedirs(normJoin(folder, self.airfield.name))
+            airfields_file = normJoin(folder, "airfields.csv")
+            with open(airfields_file, "w", encoding="utf-8") as f:
+                f.write("x,y,name\n")
+                f.write(f"{self.airfield.x},{self.airfield.y},{self.airfield.name}\n")
+
+            self.process = subprocess.Popen(self.command(folder, airfields_file),
+                                            stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+            if self.cancelled:
+                self.process.kill()
+            # the text output comes on stderr, read aside so that it cannot fill its pipe
+            logger = threading.Thread(target=self._log, args=(self.process.stderr,), daemon=True)
+            logger.start()
+            for frame in read_frames(self.process.stdout):
+                self.on_frame(frame)
+            self.process.wait()
+            logger.join()
+            if self.process.returncode != 0 and not self.cancelled:
+                error = f"compute exited with {self.process.returncode}"
+        except Exception as e:
+            error = str(e)
+        finally:
+            if self.process:
+                self.process.stdout.close()
+            shutil.rmtree(folder, ignore_errors=True)
+            self.on_done(error)
+
+    def _log(self, stream):
+        for line in stream:
+            line = line.decode("utf-8", errors="replace").rstrip()
+            if line and not line.startswith("Finished "):
+                self.on_log(line)
+        stream.close()
+
+
+def frame_to_ppm(frame, width, height):
+    """
+    The frame as a binary PPM of about width x height (kept in proportion), for
+    tk.PhotoImage: ground at 0 in dark grey, unreachable cells white, the others from
+    green (low) to red (high required altitude).
+    """
+    values = frame.values
+    nrows, ncols = values.shape
+    scale = min(width / ncols, height / nrows)
+    rows = (np.arange(max(1, int(nrows * scale))) / scale).astype(int).clip(0, nrows - 1)
+    cols = (np.arange(max(1, int(ncols * scale))) / scale).astype(int).clip(0, ncols - 1)
+    values = values[rows][:, cols]
+
+    reached = (values < frame.nodata) & (values > 0)
+    low, high = (values[reached].min(), values[reached].max()) if reached.any() else (0, 1)
+    t = np.where(reached, (values - low) / max(high - low, 1e-6), 0)
+    rgb = np.empty(values.shape + (3,), dtype=np.uint8)
+    rgb[..., 0] = (255 * t).astype(np.uint8)
+    rgb[..., 1] = (255 * (1 - t)).astype(np.uint8)
+    rgb[..., 2] = 64
+    rgb[values >= frame.nodata] = 255
+    rgb[values == 0] = 60
+    header = f"P6 {values.shape[1]} {values.shape[0]} 255\n".encode("ascii")
+    return header + rgb.tobytes()
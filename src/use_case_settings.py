@@ -45,6 +45,15 @@ class Use_case:
         self.exportPasses = config["exportPasses"]
         self.delete_previous_calculation = config["delete_previous_calculation"]
         self.clean_temporary_raster_files = config["clean_temporary_raster_files"]
+        # Optional: worker counts of the launch2.py stages (compute 0 = one thread per core)
+        # and size of the queues between them
+        cores = os.cpu_count() or 1
+        self.pipeline = {"compute": 0, "warp": max(1, cores // 2), "postprocess": 2, "queue_size": 8}
+        self.pipeline.update(config.get("pipeline") or {})
+        # Optional: MBTiles of vector tiles of the merged contours, sectors and (with
+        # exportPasses) passes, written at the end of launch2.py; off unless enabled
+        self.vector_tiles = {"enabled": False, "minzoom": 6, "maxzoom": 12}
+        self.vector_tiles.update(config.get("vector_tiles") or {})
 
         self.topography_and_crs_folder = normJoin(self.data_folder_path, self.region, "topography and CRS")
         self.airfields_folder = normJoin(self.data_folder_path, self.region, "airfields")
@@ -73,6 +82,7 @@ class Use_case:
         self.sectors2_style_filename = f"{self.sectors2_name}.mapcss" #aa_alps_20-100-250_sectors2.mapcss  
         self.sectors_filepath = normJoin(self.calculation_folder_path, self.sectors_filename) #/Users/gabrielbriffe/Downloads/MountainCircles/Alps/---RESULTS---/three/20-100-250_4200/aa_alps_20-100-250_sectors.asc
         self.sectors1_filepath = normJoin(self.calculation_folder_path, self.sectors1_filename) #/Users/gabrielbriffe/Downloads/MountainCircles/Alps/---RESULTS---/three/20-100-250_4200/aa_alps_20-100-250_sectors1.geojson 
+        self.passes_filepath = normJoin(self.calculation_folder_path, f"{self.merged_output_name}_passes.geojson") #/Users/gabrielbriffe/Downloads/MountainCircles/Alps/---RESULTS---/three/20-100-250_4200/aa_alps_20-100-250_passes.geojson
         self.sectors2_filepath = normJoin(self.calculation_folder_path, self.sectors2_filename) #/Users/gabrielbriffe/Downloads/MountainCircles/Alps/---RESULTS---/three/20-100-250_4200/aa_alps_20-100-250_sectors2.geojson 
         self.sectors1_style_filepath = normJoin(self.calculation_folder_path, self.sectors1_style_filename) #/Users/gabrielbriffe/Downloads/MountainCircles/Alps/---RESULTS---/three/20-100-250_4200/aa_alps_20-100-250_sectors1.mapcss  
         self.sectors2_style_filepath = normJoin(self.calculation_folder_path, self.sectors2_style_filename) #/Users/gabrielbriffe/Downloads/MountainCircles/Alps/---RESULTS---/three/20-100-250_4200/aa_alps_20-100-250_sectors2.mapcss      
@@ -180,8 +190,8 @@ class Use_case:
     
     def create_calculation_folder(self):
         dir_path = normJoin(self.result_folder ,self.calculation_name)
-        if not os.path.exists(dir_path):
-            os.makedirs(dir_path)
+        # several shards.py run processes may open the use case at once
+        os.makedirs(dir_path, exist_ok=True)
         return dir_path
 
     def save(self):
@@ -1,4 +1,5 @@
 import os
+import subprocess
 from pyproj import CRS
 import numpy as np
 from pyproj import Transformer
@@ -251,22 +252,29 @@ def resample_from_tm_to_wgs84(header, data, crs, target_res=0.0009, subset_bound
 
     return new_dem, (lon_origin, lat_origin, target_res, new_ncols, new_nrows), (new_lon_min, new_lat_bottom, new_lon_max, new_lat_top)
 
-def main(airfield_folder, output_queue=None):
+def is_up_to_date(output_path, input_path):
+    """output_path written after input_path: a recompute in the same folder rewrites input_path"""
+    if not os.path.exists(output_path):
+        return False
+    return not os.path.exists(input_path) or os.stat(output_path).st_mtime_ns >= os.stat(input_path).st_mtime_ns
+
+def main(airfield_folder, output_queue=None, files_to_convert=None):
     # [Unchanged, kept for context]
     crs_path = normJoin(airfield_folder, "crs.txt")
     with open(crs_path, "r") as f:
         crs_string = f.read().strip()
     source_crs = CRS.from_proj4(crs_string)
 
-    files_to_convert = [("local.asc", "local4326.asc"),
-                        ("output_sub.asc", "output_sub4326.asc")]
+    if files_to_convert is None:
+        files_to_convert = [("local.asc", "local4326.asc"),
+                            ("output_sub.asc", "output_sub4326.asc")]
     
 
     for input_filename, output_filename in files_to_convert:
         input_path = normJoin(airfield_folder, input_filename)
         output_path = normJoin(airfield_folder, output_filename)
-        # if file already warped, skip
-        if os.path.exists(output_path):
+        # if file already warped since the last computation, skip
+        if is_up_to_date(output_path, input_path):
             log_output(f"File {output_path} already exists. Skipping.", output_queue)
             continue
         if not os.path.exists(input_path):
@@ -289,6 +297,32 @@ def main(airfield_folder, output_queue=None):
             f.write(f"NODATA_value {header['nodata_value']}\n")
             np.savetxt(f, new_dem, fmt="%.6f", delimiter=" ")
 
+def main_native(calculation_script_path, airfield_folder, output_queue=None, files_to_convert=None):
+    """
+    Same files as main, resampled by the compute binary ("compute warp"), which projects
+    each target cell centre back into the regular TM grid instead of triangulating the
+    source points. Unlike resample_from_tm_to_wgs84, yllcorner is the bottom edge of the
+    written grid (top - nrows * cellsize).
+    """
+    crs_path = normJoin(airfield_folder, "crs.txt")
+    if files_to_convert is None:
+        files_to_convert = [("local.asc", "local4326.asc"),
+                            ("output_sub.asc", "output_sub4326.asc")]
+
+    for input_filename, output_filename in files_to_convert:
+        input_path = normJoin(airfield_folder, input_filename)
+        output_path = normJoin(airfield_folder, output_filename)
+        if is_up_to_date(output_path, input_path):
+            log_output(f"File {output_path} already exists. Skipping.", output_queue)
+            continue
+        if not os.path.exists(input_path):
+            log_output(f"File {input_path} does not exist. Skipping.", output_queue)
+            continue
+        log_output(f"warping {os.path.basename(input_path)}", output_queue)
+
+        subprocess.run([calculation_script_path, "warp", input_path, crs_path, output_path],
+                       check=True, text=True, capture_output=True)
+
 if __name__ == "__main__":
     import sys
     if len(sys.argv) < 2:
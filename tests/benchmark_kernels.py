@@ -0,0 +1,69 @@
+"""
+Run time of the compute binary for each propagation kernel: float or --fixed-point, 4 or
+--neighbours 8, on the rugged DEM of test_compute.py (n x n cells of 100 m, home at the
+centre). Each configuration runs --repeats times in turn, and the best and median wall
+times are printed with the speed relative to float with 4 neighbours. Reading the DEM and
+writing the outputs are included and the same for all four, so the ratios understate the
+kernel's share. Run from the main folder:
+
+    python tests/benchmark_kernels.py [--compute ./compute] [--size 1201] [--repeats 5]
+
+Without --compute the binary is built with g++ -O2 into a temporary folder.
+"""
+import argparse
+import os
+import shutil
+import statistics
+import subprocess
+import tempfile
+import time
+
+from test_compute import ROOT, SETTINGS, rugged, sources, write_asc
+
+CONFIGURATIONS = [("float, 4 neighbours", []),
+                  ("fixed, 4 neighbours", ["--fixed-point", "1"]),
+                  ("float, 8 neighbours", ["--neighbours", "8"]),
+                  ("fixed, 8 neighbours", ["--fixed-point", "1", "--neighbours", "8"])]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Time the propagation kernels of the compute binary.")
+    parser.add_argument("--compute", help="compute binary (built into a temporary folder otherwise)")
+    parser.add_argument("--size", type=int, default=1201, help="DEM side in cells (default 1201)")
+    parser.add_argument("--repeats", type=int, default=5, help="runs of each configuration (default 5)")
+    args = parser.parse_args()
+
+    folder = tempfile.mkdtemp(prefix="benchmark_kernels_")
+    try:
+        compute = args.compute
+        if not compute:
+            compute = os.path.join(folder, "compute")
+            subprocess.run(["g++", "-std=c++11", "-O2", "-pthread", "-o", compute]
+                           + sources(["cpp/*.cpp", "cpp/data/*.cpp", "cpp/io/*.cpp", "cpp/geo/*.cpp"]), check=True)
+        topography = os.path.join(folder, "dem.asc")
+        write_asc(topography, rugged(n=args.size))
+        home = str(args.size // 2 * 100 + 50)
+
+        times = {name: [] for name, _ in CONFIGURATIONS}
+        # interleaved, so that a slower spell of the machine spreads over all configurations
+        for _ in range(args.repeats):
+            for name, options in CONFIGURATIONS:
+                output = os.path.join(folder, "run")
+                os.makedirs(output, exist_ok=True)
+                start = time.perf_counter()
+                subprocess.run([compute, home, home] + SETTINGS + [output, topography, "false"] + options,
+                               stdout=subprocess.DEVNULL, check=True)
+                times[name].append(time.perf_counter() - start)
+
+        reference = statistics.median(times[CONFIGURATIONS[0][0]])
+        print(f"{args.size} x {args.size} cells, {args.repeats} runs each")
+        print(f"{'kernel':<22}{'best':>9}{'median':>9}{'speed':>8}")
+        for name, _ in CONFIGURATIONS:
+            median = statistics.median(times[name])
+            print(f"{name:<22}{min(times[name]):>8.3f}s{median:>8.3f}s{reference / median:>7.2f}x")
+    finally:
+        shutil.rmtree(folder, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
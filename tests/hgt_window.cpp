@@ -0,0 +1,13 @@
+// Writes the window of a folder of .hgt tiles within the bounds given in degrees as an
+// .asc file: hgt_window folder west south east north window.asc
+#include "../cpp/io/HgtMosaic.h"
+
+#include <string>
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc != 7) return 2;
+    HgtMosaic tiles(argv[1]);
+    tiles.window(stod(argv[2]), stod(argv[3]), stod(argv[4]), stod(argv[5])).write(argv[6]);
+    return 0;
+}
@@ -0,0 +1,688 @@
+"""
+Regression checks of the compute binary and of the launch2.py pipeline around it, run with
+`python -m unittest discover tests` from the main folder. The binary is built with g++ into
+a temporary folder, as in the README, unless COMPUTE names one already built. Most checks
+run on a rugged synthetic DEM (spectral fractal, 601 x 601 cells of 100 m, 300 to 2800 m)
+where the propagation is long enough to cross several checkpoint slices and to make
+queue-order effects visible; the pipeline checks run whole use cases on a smaller one in
+EPSG:4326.
+"""
+import contextlib
+import glob
+import io
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+import unittest
+
+import numpy as np
+import yaml
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+SOURCES = ["cpp/*.cpp", "cpp/data/*.cpp", "cpp/io/*.cpp", "cpp/geo/*.cpp"]
+HOME = ("30050", "30050")
+SETTINGS = ["20", "50", "150", "4000"]          # finesse, ground clearance, circuit, max altitude
+
+build_folder = None
+compute = None
+
+
+def sources(patterns):
+    return [path for pattern in patterns for path in sorted(glob.glob(os.path.join(ROOT, pattern)))]
+
+
+def build(name, files):
+    path = os.path.join(build_folder, name)
+    subprocess.run(["g++", "-std=c++11", "-O2", "-pthread", "-o", path] + files, check=True)
+    return path
+
+
+def setUpModule():
+    global build_folder, compute
+    build_folder = tempfile.mkdtemp(prefix="compute_tests_")
+    compute = os.environ.get("COMPUTE") or build("compute", sources(SOURCES))
+
+
+def tearDownModule():
+    shutil.rmtree(build_folder, ignore_errors=True)
+
+
+def rugged(n=601, seed=1, relief=2500.0):
+    rng = np.random.default_rng(seed)
+    f = np.fft.fftfreq(n)
+    k = np.sqrt(f[:, None] ** 2 + f[None, :] ** 2)
+    k[0, 0] = 1
+    spectrum = (rng.normal(size=(n, n)) + 1j * rng.normal(size=(n, n))) / k ** 1.6
+    z = np.real(np.fft.ifft2(spectrum))
+    z = (z - z.min()) / (z.max() - z.min())
+    return np.round(300 + relief * z ** 1.3, 1)
+
+
+def write_asc(path, z, cellsize=100.0):
+    nrows, ncols = z.shape
+    with open(path, "w") as f:
+        f.write(f"ncols {ncols}\nnrows {nrows}\nxllcorner 0\nyllcorner 0\ncellsize {cellsize}\n")
+        np.savetxt(f, z, fmt="%.1f")
+
+
+def read_asc(path):
+    with open(path) as f:
+        header = dict(next(f).split() for _ in range(6))
+        values = np.loadtxt(f, dtype=np.float64)
+    return header, values
+
+
+def run_compute(topography, folder, *options, check=True):
+    os.makedirs(folder, exist_ok=True)
+    command = [compute] + list(HOME) + SETTINGS + [folder, topography, "false"] + list(options)
+    return subprocess.run(command, capture_output=True, text=True, check=check)
+
+
+def output(folder):
+    with open(os.path.join(folder, "output_sub.asc"), "rb") as f:
+        return f.read()
+
+
+class ComputeTestCase(unittest.TestCase):
+    """A rugged DEM written once per class, with folders for the runs"""
+
+    @classmethod
+    def setUpClass(cls):
+        cls.folder = tempfile.mkdtemp(prefix="compute_case_")
+        cls.elevations = rugged()
+        cls.topography = os.path.join(cls.folder, "dem.asc")
+        write_asc(cls.topography, cls.elevations)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.folder, ignore_errors=True)
+
+    @classmethod
+    def run_folder(cls, name):
+        return os.path.join(cls.folder, name)
+
+
+class FixedPointTest(ComputeTestCase):
+    """--fixed-point against the float propagation, with 4 and 8 neighbours"""
+
+    def test_close_to_the_float_path(self):
+        for neighbours in ("4", "8"):
+            with self.subTest(neighbours=neighbours):
+                run_compute(self.topography, self.run_folder(f"float{neighbours}"), "--neighbours", neighbours)
+                run_compute(self.topography, self.run_folder(f"fixed{neighbours}"), "--neighbours", neighbours,
+                            "--fixed-point", "1")
+                _, floats = read_asc(os.path.join(self.run_folder(f"float{neighbours}"), "local.asc"))
+                _, fixed = read_asc(os.path.join(self.run_folder(f"fixed{neighbours}"), "local.asc"))
+                nodata = float(SETTINGS[3])
+                reached = (floats < nodata) & (fixed < nodata)
+                # every altitude a whole number of decimetres (the DEM is in decimetres too)
+                np.testing.assert_allclose(fixed[reached] * 10, np.round(fixed[reached] * 10), rtol=0, atol=1e-3)
+                # each hop rounds the glide loss by up to 5 cm and can change which candidate the
+                # queue keeps: small on average, a few metres where another origin wins
+                difference = np.abs(fixed - floats)[reached]
+                self.assertLess(difference.mean(), 0.3)
+                self.assertLess(np.percentile(difference, 99), 2.5)
+                self.assertLess(difference.max(), 30)
+                self.assertLess(((floats < nodata) != (fixed < nodata)).sum(), reached.sum() / 5000)
+
+    def test_unknown_flag_values_are_refused(self):
+        for option in ("--fixed-point", "--resume"):
+            with self.subTest(option=option):
+                result = run_compute(self.topography, self.run_folder("refused"), option, "yes", check=False)
+                self.assertNotEqual(result.returncode, 0)
+                self.assertIn(f"Invalid value for {option}", result.stdout + result.stderr)
+
+
+class CheckpointTest(ComputeTestCase):
+    """A run resumed from a checkpoint gives byte for byte the output of the run it was taken from"""
+
+    def test_resume_matches_the_uninterrupted_run(self):
+        checkpoint = self.run_folder("run.ckpt")
+        kept = self.run_folder("kept.ckpt")
+        folder = self.run_folder("uninterrupted")
+        os.makedirs(folder)
+        command = [compute] + list(HOME) + SETTINGS + [folder, self.topography, "false",
+                                                        "--checkpoint", checkpoint, "--checkpoint-every", "0.001"]
+        process = subprocess.Popen(command, stdout=subprocess.DEVNULL)
+        # the checkpoint is renamed in whole and deleted at the end: a hard link keeps the last one seen
+        while process.poll() is None and not os.path.exists(kept):
+            try:
+                os.link(checkpoint, kept)
+            except FileNotFoundError:
+                time.sleep(0.001)
+        self.assertEqual(process.wait(), 0)
+        self.assertTrue(os.path.exists(kept), "the run ended before a checkpoint could be taken")
+
+        resumed = run_compute(self.topography, self.run_folder("resumed"), "--checkpoint", kept, "--resume", "1")
+        self.assertIn("Resuming from", resumed.stdout)
+        self.assertEqual(output(self.run_folder("resumed")), output(folder))
+
+
+class ComputeExtTest(ComputeTestCase):
+    """compute_ext.compute_airfield against the binary's output_sub.asc and mountain_passes.csv"""
+
+    def test_matches_the_binary(self):
+        import importlib.util
+        import sysconfig
+
+        library = build("compute_ext" + sysconfig.get_config_var("EXT_SUFFIX"),
+                        ["-shared", "-fPIC", "-I" + sysconfig.get_paths()["include"], "-I" + np.get_include(),
+                         os.path.join(ROOT, "cpp", "python", "ComputeModule.cpp")]
+                        + sources(["cpp/data/*.cpp", "cpp/io/*.cpp", "cpp/geo/*.cpp"]))
+        spec = importlib.util.spec_from_file_location("compute_ext", library)
+        compute_ext = importlib.util.module_from_spec(spec)
+        spec.loader.exec_module(compute_ext)
+
+        folder = self.run_folder("binary")
+        os.makedirs(folder)
+        subprocess.run([compute] + list(HOME) + SETTINGS + [folder, self.topography, "true"], capture_output=True,
+                       check=True)
+        header, dem = compute_ext.read_asc(self.topography)
+        result = compute_ext.compute_airfield(dem, header, *map(float, SETTINGS), home=tuple(map(float, HOME)),
+                                              passes=True)
+
+        expected_header, expected = read_asc(os.path.join(folder, "output_sub.asc"))
+        altitude = result["altitude"]
+        self.assertEqual(altitude.dtype, np.float32)
+        self.assertEqual(altitude.shape, expected.shape)
+        for key in ("xllcorner", "yllcorner", "cellsize"):
+            self.assertEqual(result["header"][key], float(expected_header[key]))
+        # the binary writes 6 significant digits
+        np.testing.assert_array_equal(np.char.mod("%g", altitude).astype(float), expected)
+
+        passes = np.loadtxt(os.path.join(folder, "mountain_passes.csv"), delimiter=",", skiprows=1,
+                            usecols=(1, 2, 3), ndmin=2)
+        self.assertGreater(len(passes), 0)
+        self.assertEqual(len(result["passes"]), len(passes))
+        np.testing.assert_array_equal(np.char.mod("%g", result["passes"]["x"]).astype(float), passes[:, 0])
+        np.testing.assert_array_equal(np.char.mod("%g", result["passes"]["y"]).astype(float), passes[:, 1])
+        np.testing.assert_array_equal(result["passes"]["weight"], passes[:, 2])
+
+        # the arrays are the C++ buffers, owned through a capsule, not copies
+        for array in (altitude, result["passes"], dem):
+            self.assertEqual(type(array.base).__name__, "PyCapsule")
+            self.assertFalse(array.flags["OWNDATA"])
+
+        # the encoding error of an option reaches the caller
+        with self.assertRaises(UnicodeEncodeError):
+            compute_ext.compute_airfield(dem, header, *map(float, SETTINGS), options={"--neighbours": "\ud800"})
+
+
+def write_use_case(folder, airfields, **settings):
+    """
+    A use case under folder in the layout of use_case_settings.py: a 451 x 451 EPSG:4326
+    DEM of 0.002 degree from 6E 45N, the compute binary, the Guru Maps styles and the given
+    (name, lon, lat) airfields. settings override the use case keys. Returns the .yaml path,
+    named after the use case so that several use cases can share the folder and its DEM.
+    """
+    region = os.path.join(folder, "region")
+    topography = os.path.join(region, "topography and CRS")
+    os.makedirs(topography, exist_ok=True)
+    elevations = rugged(n=451, seed=5, relief=2200.0)
+    with open(os.path.join(topography, "dem.asc"), "w") as f:
+        f.write("ncols 451\nnrows 451\nxllcorner 6.0\nyllcorner 45.0\ncellsize 0.002\n")
+        np.savetxt(f, elevations, fmt="%.1f")
+    with open(os.path.join(topography, "crs.txt"), "w") as f:
+        f.write("+proj=lcc +lat_0=45.7 +lon_0=10.5 +lat_1=44 +lat_2=47.4 +x_0=700000 +y_0=250000 "
+                "+datum=WGS84 +units=m +no_defs\n")
+    script = os.path.join(folder, "common files", "calculation script")
+    os.makedirs(script, exist_ok=True)
+    shutil.copy(compute, os.path.join(script, "compute"))
+    styles = os.path.join(folder, "common files", "Guru Map styles")
+    shutil.copytree(os.path.join(ROOT, "templates"), styles, dirs_exist_ok=True)
+    shutil.copy(os.path.join(styles, "mapcss.mapcss"), os.path.join(styles, "circlesAndAirfields.mapcss"))
+
+    airfield_file = os.path.join(folder, "airfields.csv")
+    with open(airfield_file, "w") as f:
+        f.write("name,x,y\n" + "".join(f"{name},{lon},{lat}\n" for name, lon, lat in airfields))
+    config = {"data_folder_path": folder, "region": "region", "use_case_name": "test",
+              "airfield_file": airfield_file, "calculation_script": "compute",
+              "glide_ratio": 20, "ground_clearance": 50, "circuit_height": 150, "max_altitude": 2500,
+              "contour_height": 100, "merged_prefix": "aa", "gurumaps_styles": False, "exportPasses": False,
+              "delete_previous_calculation": False, "clean_temporary_raster_files": False,
+              "pipeline": {"compute": 2, "warp": 2, "postprocess": 1, "queue_size": 4}}
+    config.update(settings)
+    path = os.path.join(folder, f"{config['use_case_name']}.yaml")
+    with open(path, "w") as f:
+        yaml.safe_dump(config, f)
+    return path
+
+
+def quietly(function, *args):
+    with contextlib.redirect_stdout(io.StringIO()):
+        return function(*args)
+
+
+def merged_rasters(use_case):
+    """Header and values of the merged raster and of the sectors raster of a use case"""
+    sectors = os.path.join(use_case.calculation_folder_path, "sector_raster", use_case.sectors_filename)
+    if not os.path.exists(sectors):
+        sectors = use_case.sectors_filepath
+    return read_asc(use_case.merged_output_raster_path), read_asc(sectors)
+
+
+def on_grid(header, values, reference):
+    """values cut (or padded with nodata) to the lattice of the reference header"""
+    cellsize = float(header["cellsize"])
+    col = int(round((float(reference["xllcorner"]) - float(header["xllcorner"])) / cellsize))
+    top = float(header["yllcorner"]) + values.shape[0] * cellsize
+    row = int(round((top - (float(reference["yllcorner"]) + int(reference["nrows"]) * cellsize)) / cellsize))
+    out = np.full((int(reference["nrows"]), int(reference["ncols"])), float(header["NODATA_value"]))
+    rows, cols = np.indices(out.shape)
+    inside = (rows + row >= 0) & (rows + row < values.shape[0]) & (cols + col >= 0) & (cols + col < values.shape[1])
+    out[inside] = values[(rows + row)[inside], (cols + col)[inside]]
+    return out, (values != float(header["NODATA_value"])).sum() - (out != float(header["NODATA_value"])).sum()
+
+
+class MosaicTest(unittest.TestCase):
+    """The persisted mosaic after adding and removing airfields is the merge of the airfields left"""
+
+    AIRFIELDS = [("A", 6.3, 45.3), ("B", 6.45, 45.45), ("C", 6.6, 45.6)]
+
+    def setUp(self):
+        self.folder = tempfile.mkdtemp(prefix="mosaic_case_")
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def run_with(self, names):
+        import launch2
+        from src.use_case_settings import Use_case
+
+        path = write_use_case(self.folder, [airfield for airfield in self.AIRFIELDS if airfield[0] in names])
+        quietly(launch2.main, path)
+        return quietly(Use_case, path)
+
+    def test_add_then_remove_matches_a_full_merge(self):
+        from src.raster import merge_output_rasters2
+
+        self.run_with("AB")
+        self.run_with("ABC")
+        use_case = self.run_with("AC")
+        (header, altitude), (_, sectors) = merged_rasters(use_case)
+
+        quietly(merge_output_rasters2, use_case, None, None)
+        (expected_header, expected_altitude), (_, expected_sectors) = merged_rasters(use_case)
+        # the mosaic grid only grows: what B alone covered is left as nodata around
+        altitude, lost = on_grid(header, altitude, expected_header)
+        self.assertEqual(lost, 0)
+        sectors, _ = on_grid(header, sectors, expected_header)
+        np.testing.assert_array_equal(altitude, expected_altitude)
+
+        # same sectors, numbered in merge order by one and by owner id by the other
+        nodata = float(expected_header["NODATA_value"])
+        np.testing.assert_array_equal(sectors == nodata, expected_sectors == nodata)
+        pairs = set(zip(sectors[sectors != nodata], expected_sectors[expected_sectors != nodata]))
+        self.assertEqual(len(pairs), 2)
+        self.assertEqual(len({a for a, _ in pairs}), 2)
+        self.assertEqual(len({b for _, b in pairs}), 2)
+
+    def test_contour_height_rebuilds_the_mosaic(self):
+        import launch2
+
+        path = write_use_case(self.folder, self.AIRFIELDS[:1])
+        quietly(launch2.main, path)
+        path = write_use_case(self.folder, self.AIRFIELDS[:1], contour_height=200)
+        output = io.StringIO()
+        with contextlib.redirect_stdout(output):
+            launch2.main(path)
+        self.assertIn("rebuilding the mosaic", output.getvalue())
+        self.assertIn("1 to compute", output.getvalue())
+
+    def test_failed_warp_fails_the_run_and_stays_pending(self):
+        import launch2
+        from unittest import mock
+
+        warp = launch2.warp
+
+        def failing(script, folder, **kwargs):
+            if os.path.basename(folder) == "B":
+                raise RuntimeError("warp failed")
+            return warp(script, folder, **kwargs)
+
+        path = write_use_case(self.folder, self.AIRFIELDS[:2])
+        with mock.patch.object(launch2, "warp", failing):
+            with self.assertRaisesRegex(RuntimeError, "left out of the map: 1 airfields could not be processed: B"):
+                quietly(launch2.main, path)
+        output = io.StringIO()
+        with contextlib.redirect_stdout(output):
+            launch2.main(path)
+        self.assertIn("1 airfields up to date, 1 to compute", output.getvalue())
+
+    def test_propagation_version_rebuilds_the_mosaic(self):
+        import launch2
+
+        path = write_use_case(self.folder, self.AIRFIELDS[:1])
+        quietly(launch2.main, path)
+        # the same binary behind a script answering another version
+        script = os.path.join(self.folder, "common files", "calculation script", "compute")
+        os.replace(script, script + ".real")
+        with open(script, "w") as f:
+            f.write(f'#!/bin/sh\n[ "$1" = --version ] && echo 2 && exit 0\nexec "{script}.real" "$@"\n')
+        os.chmod(script, 0o755)
+        output = io.StringIO()
+        with contextlib.redirect_stdout(output):
+            launch2.main(path)
+        self.assertIn("rebuilding the mosaic", output.getvalue())
+        self.assertIn("1 to compute", output.getvalue())
+
+
+class ShardsTest(unittest.TestCase):
+    """Two utils/shards.py run processes merged in either order give the result of one launch2.py run"""
+
+    AIRFIELDS = MosaicTest.AIRFIELDS
+
+    def setUp(self):
+        self.folder = tempfile.mkdtemp(prefix="shards_case_")
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def shards(self, *args):
+        return [sys.executable, os.path.join(ROOT, "utils", "shards.py")] + list(args)
+
+    def test_merged_shards_match_a_single_run(self):
+        import launch2
+        from src.use_case_settings import Use_case
+
+        single = write_use_case(self.folder, self.AIRFIELDS, use_case_name="single")
+        quietly(launch2.main, single)
+        expected = merged_rasters(quietly(Use_case, single))
+
+        nodes = write_use_case(self.folder, self.AIRFIELDS, use_case_name="nodes")
+        bundles = [os.path.join(self.folder, f"bundle{k}") for k in (1, 2)]
+        processes = [subprocess.Popen(self.shards("run", nodes, bundle, "--shard", f"{k}/2"), cwd=ROOT,
+                                      stdout=subprocess.DEVNULL)
+                     for k, bundle in enumerate(bundles, 1)]
+        self.assertEqual([process.wait() for process in processes], [0, 0])
+
+        for name, order in (("forward", bundles), ("backward", bundles[::-1])):
+            with self.subTest(order=name):
+                merged = write_use_case(self.folder, self.AIRFIELDS, use_case_name=name)
+                subprocess.run(self.shards("merge", merged, *order), cwd=ROOT, stdout=subprocess.DEVNULL,
+                               check=True)
+                (header, altitude), (sectors_header, sectors) = merged_rasters(quietly(Use_case, merged))
+                (expected_header, expected_altitude), (expected_sectors_header, expected_sectors) = expected
+                self.assertEqual(header, expected_header)
+                self.assertEqual(sectors_header, expected_sectors_header)
+                np.testing.assert_array_equal(altitude, expected_altitude)
+                np.testing.assert_array_equal(sectors, expected_sectors)
+
+    def test_merge_refuses_bundles_of_other_settings(self):
+        nodes = write_use_case(self.folder, self.AIRFIELDS[:1], use_case_name="nodes")
+        bundle = os.path.join(self.folder, "bundle")
+        subprocess.run(self.shards("run", nodes, bundle, "--shard", "1/1"), cwd=ROOT, stdout=subprocess.DEVNULL,
+                       check=True)
+        for setting in ({"contour_height": 50}, {"exportPasses": True}):
+            with self.subTest(setting=setting):
+                merged = write_use_case(self.folder, self.AIRFIELDS[:1], use_case_name="merged", **setting)
+                result = subprocess.run(self.shards("merge", merged, bundle), cwd=ROOT, capture_output=True,
+                                        text=True)
+                self.assertNotEqual(result.returncode, 0)
+                self.assertIn(f"bundles have {next(iter(setting))}", result.stderr)
+
+
+class TransverseMercatorTest(unittest.TestCase):
+    """cpp/geo/TransverseMercator against pyproj, on the CRS written by extract_project_tm.py"""
+
+    CENTRES = [(6.0, 45.0), (-1.5, 43.2), (10.9, 46.5), (-70.0, -33.0), (140.0, 65.0)]
+
+    def test_matches_pyproj(self):
+        from pyproj import Transformer
+
+        tm_points = build("tm_points", [os.path.join(ROOT, "tests", "tm_points.cpp"),
+                                        os.path.join(ROOT, "cpp", "geo", "TransverseMercator.cpp")])
+        rng = np.random.default_rng(2)
+        for lon_0, lat_0 in self.CENTRES:
+            proj4 = f"+proj=tmerc +lat_0={lat_0} +lon_0={lon_0} +k=1 +x_0=0 +y_0=0 +ellps=WGS84 +units=m +no_defs"
+            # up to ~3 degrees (250 km) away: the radius of a 4000 m glide at 60
+            lons = lon_0 + rng.uniform(-3, 3, 200)
+            lats = lat_0 + rng.uniform(-2.5, 2.5, 200)
+            text = proj4 + "\n" + "".join(f"{lon:.12f} {lat:.12f}\n" for lon, lat in zip(lons, lats))
+            result = subprocess.run([tm_points], input=text, capture_output=True, text=True, check=True)
+            x, y, lon2, lat2 = np.loadtxt(result.stdout.splitlines(), ndmin=2).T
+
+            expected_x, expected_y = Transformer.from_crs("EPSG:4326", proj4, always_xy=True).transform(lons, lats)
+            with self.subTest(centre=(lon_0, lat_0)):
+                np.testing.assert_allclose(x, expected_x, rtol=0, atol=1e-3)
+                np.testing.assert_allclose(y, expected_y, rtol=0, atol=1e-3)
+                # round trip within 1e-9 degree, about 0.1 mm
+                np.testing.assert_allclose(lon2, lons, rtol=0, atol=1e-9)
+                np.testing.assert_allclose(lat2, lats, rtol=0, atol=1e-9)
+
+
+class WarpTest(unittest.TestCase):
+    """compute warp (cpp/geo/Warp) against resample_from_tm_to_wgs84 of src/warp.py: same lattice, same ground and nodata"""
+
+    PROJ4 = "+proj=tmerc +lat_0=45 +lon_0=6 +k=1 +x_0=0 +y_0=0 +ellps=WGS84 +units=m +no_defs"
+
+    def setUp(self):
+        self.folder = tempfile.mkdtemp(prefix="warp_case_")
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def write_airfield(self, z):
+        """output_sub.asc and crs.txt of an airfield folder, returns their paths"""
+        source = os.path.join(self.folder, "output_sub.asc")
+        with open(source, "w") as f:
+            f.write("ncols 80\nnrows 80\nxllcorner -4000\nyllcorner -4000\ncellsize 100\nNODATA_value -9999\n")
+            np.savetxt(f, z, fmt="%.1f")
+        crs = os.path.join(self.folder, "crs.txt")
+        with open(crs, "w") as f:
+            f.write(self.PROJ4)
+        return source, crs
+
+    def test_masks_match_warp_py(self):
+        from pyproj import CRS
+        from src import warp
+
+        # a nodata border that read_asc trims, ground patches and a nodata hole inside
+        z = rugged(80, seed=4, relief=1500.0)
+        z[:, :3] = -9999
+        z[-2:, :] = -9999
+        z[20:35, 30:50] = 0
+        z[40:44, 60:63] = 0
+        z[50:62, 10:25] = -9999
+        source, crs = self.write_airfield(z)
+        target = os.path.join(self.folder, "output_sub4326.asc")
+        subprocess.run([compute, "warp", source, crs, target], capture_output=True, check=True)
+
+        header, native = read_asc(target)
+        expected, (lon_origin, lat_origin, _, ncols, nrows), _ = warp.resample_from_tm_to_wgs84(
+            *warp.read_asc(source), CRS.from_proj4(self.PROJ4))
+        self.assertEqual(native.shape, (nrows, ncols))
+        self.assertAlmostEqual(float(header["xllcorner"]), lon_origin, places=6)
+        top = float(header["yllcorner"]) + nrows * float(header["cellsize"])
+        self.assertAlmostEqual(top, lat_origin, places=6)
+        for value in (0, -9999):
+            with self.subTest(value=value):
+                self.assertTrue((expected == value).any())
+                np.testing.assert_array_equal(native == value, expected == value)
+
+    def test_recomputed_airfield_is_warped_again(self):
+        from src import warp
+
+        z = rugged(80, seed=4, relief=1500.0)
+        source, _ = self.write_airfield(z)
+        target = os.path.join(self.folder, "output_sub4326.asc")
+        quietly(warp.main_native, compute, self.folder)
+        _, first = read_asc(target)
+        quietly(warp.main_native, compute, self.folder)
+        _, again = read_asc(target)
+        np.testing.assert_array_equal(again, first)
+
+        # recomputed with other settings after the warp
+        self.write_airfield(z + 100)
+        later = os.stat(target).st_mtime_ns + 10 ** 9
+        os.utime(source, ns=(later, later))
+        quietly(warp.main_native, compute, self.folder)
+        _, warped = read_asc(target)
+        self.assertGreater(warped.max(), first.max() + 99)
+
+
+class HgtMosaicTest(unittest.TestCase):
+    """cpp/io/HgtMosaic windows of two synthetic .hgt tiles against the same DEM as one .asc"""
+
+    VOID = -32768
+    CELLSIZE = 1 / 1200
+
+    @classmethod
+    def setUpClass(cls):
+        cls.folder = tempfile.mkdtemp(prefix="hgt_case_")
+        cls.tiles = os.path.join(cls.folder, "hgt")
+        os.makedirs(cls.tiles)
+        # N45E006 and N45E007 share the column of longitude 7, voids inside and on it
+        cls.dem = np.round(rugged(2401, seed=5, relief=1200.0)[:1201]).astype(np.int16)
+        cls.dem[300:340, 200:260] = cls.VOID
+        west, east = cls.dem[:, :1201].copy(), cls.dem[:, 1200:].copy()
+        west[100:110, -1] = cls.VOID            # the east tile's value is kept
+        east[900:905, 0] = cls.VOID
+        west.astype(">i2").tofile(os.path.join(cls.tiles, "N45E006.hgt"))
+        east.astype(">i2").tofile(os.path.join(cls.tiles, "n45e007.hgt"))
+        cls.topography = os.path.join(cls.folder, "dem.asc")
+        with open(cls.topography, "w") as f:
+            f.write(f"ncols 2401\nnrows 1201\nxllcorner {6 - cls.CELLSIZE / 2!r}\nyllcorner {45 - cls.CELLSIZE / 2!r}\n"
+                    f"cellsize {cls.CELLSIZE!r}\nNODATA_value {cls.VOID}\n")
+            np.savetxt(f, cls.dem, fmt="%d")
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.folder, ignore_errors=True)
+
+    def test_windows_match_the_asc(self):
+        hgt_window = build("hgt_window", [os.path.join(ROOT, "tests", "hgt_window.cpp"),
+                                          os.path.join(ROOT, "cpp", "io", "HgtMosaic.cpp"),
+                                          os.path.join(ROOT, "cpp", "io", "AscGrid.cpp")])
+        margin = 1000
+        padded = np.full((1201 + 2 * margin, 2401 + 2 * margin), self.VOID, dtype=np.float64)
+        padded[margin:-margin, margin:-margin] = self.dem
+        # across the shared column, past the north-east corner, past the south-west corner
+        for bounds in [(6.8, 45.2, 7.3, 45.6), (7.5, 45.7, 8.2, 46.3), (5.5, 44.5, 6.1, 45.05)]:
+            path = os.path.join(self.folder, "window.asc")
+            subprocess.run([hgt_window, self.tiles] + [str(v) for v in bounds] + [path], check=True)
+            header, values = read_asc(path)
+            xll, yll = float(header["xllcorner"]), float(header["yllcorner"])
+            nrows, ncols = values.shape
+            j = round((xll - (6 - self.CELLSIZE / 2)) / self.CELLSIZE)
+            i = round((46 + self.CELLSIZE / 2 - yll) / self.CELLSIZE) - nrows
+            with self.subTest(bounds=bounds):
+                self.assertLessEqual(xll, bounds[0])
+                self.assertLessEqual(yll, bounds[1])
+                self.assertGreaterEqual(xll + ncols * self.CELLSIZE, bounds[2])
+                self.assertGreaterEqual(yll + nrows * self.CELLSIZE, bounds[3])
+                np.testing.assert_array_equal(values, padded[margin + i:margin + i + nrows, margin + j:margin + j + ncols])
+
+    def test_batch_reads_the_same_topography(self):
+        airfields = os.path.join(self.folder, "airfields.csv")
+        with open(airfields, "w") as f:
+            f.write("x,y,name\n7.0,45.5,field\n")
+        results = []
+        for topography, name in ((self.tiles, "from_hgt"), (self.topography, "from_asc")):
+            folder = os.path.join(self.folder, name)
+            os.makedirs(os.path.join(folder, "field"))
+            # 2500 m keeps the square inside the two tiles
+            subprocess.run([compute, "batch", topography, airfields] + SETTINGS[:3] + ["2500", folder, "false"],
+                           capture_output=True, check=True)
+            with open(os.path.join(folder, "field", "local.asc"), "rb") as f:
+                results.append([f.read(), output(os.path.join(folder, "field"))])
+        self.assertEqual(results[0], results[1])
+
+
+
+class SectorsTest(unittest.TestCase):
+    """compute sectors: one polygon per connected sector with its holes, adjacent sectors in other colours"""
+
+    def setUp(self):
+        self.folder = tempfile.mkdtemp(prefix="sectors_case_")
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    @staticmethod
+    def area(ring):
+        x, y = np.array(ring).T
+        return (np.dot(x[:-1], y[1:]) - np.dot(x[1:], y[:-1])) / 2
+
+    def test_rings_and_colours(self):
+        # bricks of random sizes on the left, on the right one sector holding an island
+        # sector and a nodata hole
+        rng = np.random.default_rng(3)
+        ids = np.full((80, 80), -1)
+        sector = 0
+        left = 0
+        for width in (7, 12, 9, 12):
+            top = 0
+            while top < 80:
+                height = int(rng.integers(5, 15))
+                ids[top:top + height, left:left + width] = sector
+                sector += 1
+                top += height
+            left += width
+        ids[:, 40:] = 50
+        ids[10:20, 50:60] = 51
+        ids[40:50, 55:65] = -1
+        cellsize = 0.01
+        raster = os.path.join(self.folder, "sectors.asc")
+        with open(raster, "w") as f:
+            f.write(f"ncols 80\nnrows 80\nxllcorner 6.0\nyllcorner 45.0\ncellsize {cellsize}\nNODATA_value -1\n")
+            np.savetxt(f, ids, fmt="%d")
+        output = os.path.join(self.folder, "sectors.geojson")
+        subprocess.run([compute, "sectors", raster, output, "--simplify", "0", "--colors", "7"], check=True,
+                       capture_output=True)
+        with open(output) as f:
+            features = {feature["properties"]["sector"]: feature for feature in json.load(f)["features"]}
+
+        self.assertEqual(set(features), set(np.unique(ids[ids >= 0])))
+        for value, feature in features.items():
+            with self.subTest(sector=value):
+                self.assertEqual(feature["geometry"]["type"], "Polygon")
+                exterior, *holes = feature["geometry"]["coordinates"]
+                self.assertEqual(len(holes), 2 if value == 50 else 0)
+                self.assertGreater(self.area(exterior), 0)
+                for hole in holes:
+                    self.assertLess(self.area(hole), 0)
+                # not simplified: the rings follow the cell edges
+                area = sum(self.area(ring) for ring in [exterior] + holes)
+                self.assertAlmostEqual(area, (ids == value).sum() * cellsize ** 2, places=9)
+
+        # 4-neighbours of different sectors
+        pairs = set()
+        for a, b in ((ids[:, :-1], ids[:, 1:]), (ids[:-1], ids[1:])):
+            touching = (a != b) & (a >= 0) & (b >= 0)
+            pairs |= set(zip(a[touching], b[touching]))
+        self.assertGreater(len(pairs), 10)
+        colours = {value: feature["properties"]["color_id"] for value, feature in features.items()}
+        self.assertTrue(all(0 <= colour < 7 for colour in colours.values()))
+        for a, b in pairs:
+            self.assertNotEqual(colours[a], colours[b], (a, b))
+
+    def test_sectors_under_min_area_are_not_coloured(self):
+        # one cell of sector 2 touching 0, 1 and 3: if kept, it would be coloured first and
+        # leave 0 and 1 without a second colour
+        ids = np.full((20, 20), -1)
+        ids[:15, :10] = 0
+        ids[:15, 10:] = 1
+        ids[14, 10] = 2
+        ids[15:, 10] = 3
+        raster = os.path.join(self.folder, "sectors.asc")
+        with open(raster, "w") as f:
+            f.write("ncols 20\nnrows 20\nxllcorner 6.0\nyllcorner 45.0\ncellsize 0.01\nNODATA_value -1\n")
+            np.savetxt(f, ids, fmt="%d")
+        output = os.path.join(self.folder, "sectors.geojson")
+        subprocess.run([compute, "sectors", raster, output, "--simplify", "0", "--colors", "2",
+                        "--min-area", "0.0002", "--adjacency-distance", "0"], check=True, capture_output=True)
+        with open(output) as f:
+            colours = {feature["properties"]["sector"]: feature["properties"]["color_id"]
+                       for feature in json.load(f)["features"]}
+        self.assertEqual(set(colours), {0, 1, 3})
+        self.assertNotEqual(colours[0], colours[1])
+        self.assertTrue(all(colour < 2 for colour in colours.values()), colours)
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,23 @@
+// Reads a proj4 string on the first line, then "lon lat" lines, and prints for each
+// "x y lon lat": the forward projection and the inverse of that, full precision
+#include "../cpp/geo/TransverseMercator.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+using namespace std;
+
+int main() {
+    string proj4;
+    getline(cin, proj4);
+    TransverseMercator tm = TransverseMercator::fromProj4(proj4);
+    double lon, lat;
+    cout << setprecision(17);
+    while (cin >> lon >> lat) {
+        double x, y, lon2, lat2;
+        tm.forward(lon, lat, x, y);
+        tm.inverse(x, y, lon2, lat2);
+        cout << x << " " << y << " " << lon2 << " " << lat2 << "\n";
+    }
+    return 0;
+}
@@ -7,11 +7,19 @@ the resulting image as MBTiles (tile pyramid).
 Usage:
     python tests/hillshade.py input.asc output.mbtiles [--cellsize 100]
          [--azimuth 315] [--altitude 45] [--min_zoom 10] [--max_zoom 14]
+         [--compute ./compute]
+
+With --compute, the resampling, shading and tile rendering run in the compute
+binary, several times faster.
 """
 
 import argparse
+import os
 import numpy as np
 import sqlite3
+import struct
+import subprocess
+import tempfile
 from math import ceil, floor
 from io import BytesIO
 from PIL import Image
@@ -243,21 +251,8 @@ def generate_mbtiles(slope_map, dem_transform, min_zoom, max_zoom, output_path):
     east_lon, north_lat = transformer_inv.transform(dem_east, dem_north)
 
     # Open SQLite connection and create MBTiles tables.
-    conn = sqlite3.connect(output_path)
+    conn = open_mbtiles(output_path)
     cur = conn.cursor()
-    cur.execute("CREATE TABLE IF NOT EXISTS metadata (name TEXT, value TEXT);")
-    cur.execute(
-        """CREATE TABLE IF NOT EXISTS tiles (
-           zoom_level INTEGER,
-           tile_column INTEGER,
-           tile_row INTEGER,
-           tile_data BLOB
-           );"""
-    )
-    cur.execute(
-        "CREATE UNIQUE INDEX IF NOT EXISTS tile_index on tiles (zoom_level, tile_column, tile_row);"
-    )
-    conn.commit()
 
     tile_size = 256
 
@@ -309,22 +304,99 @@ def generate_mbtiles(slope_map, dem_transform, min_zoom, max_zoom, output_path):
                 )
         conn.commit()
 
-    # Insert metadata.
-    bounds = f"{west_lon},{south_lat},{east_lon},{north_lat}"
+    write_metadata(conn, (west_lon, south_lat, east_lon, north_lat), min_zoom, max_zoom)
+    conn.close()
+    print(f"MBTiles file saved to {output_path}")
+
+
+def open_mbtiles(output_path):
+    """Opens (and creates if needed) an MBTiles database with the tiles and metadata tables."""
+    conn = sqlite3.connect(output_path)
+    cur = conn.cursor()
+    cur.execute("CREATE TABLE IF NOT EXISTS metadata (name TEXT, value TEXT);")
+    cur.execute(
+        """CREATE TABLE IF NOT EXISTS tiles (
+           zoom_level INTEGER,
+           tile_column INTEGER,
+           tile_row INTEGER,
+           tile_data BLOB
+           );"""
+    )
+    cur.execute(
+        "CREATE UNIQUE INDEX IF NOT EXISTS tile_index on tiles (zoom_level, tile_column, tile_row);"
+    )
+    conn.commit()
+    return conn
+
+
+def write_metadata(conn, bounds, min_zoom, max_zoom):
+    """Inserts the metadata of the shaded relief; bounds = (west, south, east, north) in degrees."""
     metadata = {
         "name": "Slope Map",
         "type": "overlay",
         "version": "1.0",
         "description": "Slope map generated from DEM",
         "format": "png",
-        "bounds": bounds,
+        "bounds": ",".join(str(v) for v in bounds),
         "minzoom": str(min_zoom),
         "maxzoom": str(max_zoom),
     }
+    cur = conn.cursor()
     for key, value in metadata.items():
         cur.execute("INSERT INTO metadata (name, value) VALUES (?, ?)", (key, value))
     conn.commit()
-    conn.close()
+
+
+def read_tile_pack(path):
+    """
+    Reads the tile pack written by "compute hillshade".
+
+    Returns:
+        bounds (tuple): (west, south, east, north) in degrees.
+        tiles (generator): (zoom, column, tms_row, png bytes) tuples.
+    """
+    f = open(path, "rb")
+    if f.read(4) != b"MCTP":
+        f.close()
+        raise ValueError(f"{path} is not a tile pack")
+    bounds = struct.unpack("<4d", f.read(32))
+
+    def tiles():
+        with f:
+            while True:
+                header = f.read(16)
+                if len(header) < 16:
+                    return
+                z, x, y, size = struct.unpack("<iiiI", header)
+                yield z, x, y, f.read(size)
+
+    return bounds, tiles()
+
+
+def generate_mbtiles_native(compute_path, input_asc, output_path, min_zoom=1, max_zoom=12, cellsize=100,
+                            azimuth=315, altitude=45, z_factor_slopes=1.4, z_factor_shades=2):
+    """
+    Same MBTiles as resample_to_metric + compute_hillshade + compute_normalized_slope +
+    combine_images + generate_mbtiles, with everything up to the PNG encoding done by
+    the compute binary ("compute hillshade"); only the database is written here.
+    """
+    with tempfile.TemporaryDirectory() as tmp:
+        pack_path = os.path.join(tmp, "tiles.pack")
+        command = [compute_path, "hillshade", input_asc, pack_path,
+                   "--cellsize", str(cellsize),
+                   "--min-zoom", str(min_zoom), "--max-zoom", str(max_zoom),
+                   "--azimuth", str(azimuth), "--altitude", str(altitude),
+                   "--z-slopes", str(z_factor_slopes), "--z-shades", str(z_factor_shades)]
+        subprocess.run(command, check=True)
+
+        bounds, tiles = read_tile_pack(pack_path)
+        conn = open_mbtiles(output_path)
+        conn.executemany(
+            "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)",
+            ((z, x, y, sqlite3.Binary(data)) for z, x, y, data in tiles))
+        conn.commit()
+        write_metadata(conn, bounds, min_zoom, max_zoom)
+        conn.close()
     print(f"MBTiles file saved to {output_path}")
 
 
@@ -489,8 +561,16 @@ def main():
                         help="Sun altitude angle in degrees for standard hillshade (default: 45)")
     # Optional output for the resampled DEM (for inspection).
     parser.add_argument("--output_resampled", help="Path to output resampled DEM as ASCII grid (optional)")
+    parser.add_argument("--compute", help="Path to the compute binary, to render the tiles natively (optional)")
     args = parser.parse_args()
 
+    if args.compute:
+        generate_mbtiles_native(args.compute, args.input_asc, args.output_mbtiles,
+                                min_zoom=args.min_zoom, max_zoom=args.max_zoom, cellsize=args.cellsize,
+                                azimuth=args.azimuth, altitude=args.altitude,
+                                z_factor_slopes=args.z_factor_slopes, z_factor_shades=args.z_factor_shades)
+        return
+
     header, data = read_asc(args.input_asc)
     print("Read ASC file. Header:", header)
 
@@ -254,6 +254,42 @@ def find_closest_pass(mountain_passes_path, custom_points_path, output_path):
         print(f"An error occurred: {e}")
 
 
+def merge_airfield_passes(calculation_folder, names, output_path):
+    """
+    Merge the mountain_passes.csv of the given airfields into one GeoJSON of points in
+    EPSG:4326, each with its airfield and weight. The passes of an airfield are in its own
+    transverse Mercator CRS: read from <airfield>/mountain_passes.csv with <airfield>/crs.txt,
+    or, once the airfield folder is cleaned, from individual passes/<airfield>.csv with
+    individual passes/<airfield>_crs.txt.
+
+    Returns the number of passes written.
+    """
+    passes_folder = normJoin(calculation_folder, "individual passes")
+    features = []
+    for name in names:
+        candidates = [(normJoin(calculation_folder, name, "mountain_passes.csv"), normJoin(calculation_folder, name, "crs.txt")),
+                      (normJoin(passes_folder, f"{name}.csv"), normJoin(passes_folder, f"{name}_crs.txt"))]
+        for csv_path, crs_path in candidates:
+            if os.path.exists(csv_path) and os.path.exists(crs_path):
+                break
+        else:
+            continue
+        with open(crs_path, "r") as f:
+            crs = pyproj.CRS.from_proj4(f.read().strip())
+        df = pd.read_csv(csv_path)
+        if df.empty:
+            continue
+        transformer = pyproj.Transformer.from_crs(crs, "EPSG:4326", always_xy=True)
+        lons, lats = transformer.transform(df["x"].to_numpy(), df["y"].to_numpy())
+        for lon, lat, weight in zip(lons, lats, df["weight"]):
+            features.append(Feature(geometry=Point((round(float(lon), 6), round(float(lat), 6))),
+                                    properties={"airfield": name, "weight": int(weight)}))
+
+    with open(output_path, "w") as f:
+        json.dump(FeatureCollection(features), f, separators=(",", ":"))
+    return len(features)
+
+
 def process_passes(root_folder, input_crs, intermediate_geojson_path, mountain_passes_path, output_path):
     """
     Main function to process passes from CSV to final filtered shapefile
@@ -1,4 +1,5 @@
 import shutil
+import subprocess
 import numpy as np
 from skimage import measure
 from shapely.geometry import mapping, Polygon
@@ -323,6 +324,40 @@ def main2(config, buffer_distance, number_of_colors, simplify_tolerance):
     # print(f"Sectors raster moved to {normJoin(sectors_raster_folder, config.sectors_filename)}")
 
 
+def main_native(config, buffer_distance, number_of_colors, simplify_tolerance, output_queue=None):
+    """
+    Same output as main2, vectorised and coloured by the compute binary
+    ("compute sectors"), which traces every sector in one pass over the grid.
+    buffer_distance and simplify_tolerance are in grid units (degrees here).
+    """
+    command = [
+        config.calculation_script_path, "sectors",
+        config.sectors_filepath, config.sectors1_filepath,
+        "--colors", str(number_of_colors),
+        "--min-area", "0.0001",
+        "--adjacency-distance", str(buffer_distance),
+    ]
+    if simplify_tolerance is not None:
+        command += ["--simplify", str(simplify_tolerance)]
+    result = subprocess.run(command, check=True, text=True, capture_output=True)
+    if result.stdout:
+        log_output(result.stdout, output_queue)
+    print(f"Sectors saved to {config.sectors1_filepath}")
+
+    shutil.copy(config.sectors1_filepath, config.sectors2_filepath)
+    print(f"Sectors saved to {config.sectors2_filepath}")
+
+    if config.gurumaps_styles:
+        shutil.copy(config.sector1_style_path, config.sectors1_style_filepath)
+        shutil.copy(config.sector2_style_path, config.sectors2_style_filepath)
+        print(f"Sectors style files saved to {config.sectors1_style_filepath} and {config.sectors2_style_filepath}")
+
+    sectors_raster_folder = normJoin(config.calculation_folder_path, "sector_raster")
+    if not os.path.exists(sectors_raster_folder):
+        os.makedirs(sectors_raster_folder)
+    shutil.move(config.sectors_filepath, normJoin(sectors_raster_folder, config.sectors_filename))
+
+
 if __name__ == "__main__":
     
     config = sys.argv[1]
@@ -0,0 +1,157 @@
+"""
+A use case computed on several machines (or several local processes standing in for them).
+
+  run    on each node, compute one shard of the use case's airfields into a bundle folder:
+         the airfield folders of compute batch --shard k/n, warped to EPSG:4326, and the
+         bundle.json written by the binary (parameters, topography, status of each airfield)
+  merge  on one machine, import the airfields of any set of bundles into the use case's
+         calculation folder and build the mosaic, sectors and vector tiles as launch2.py does
+
+Nodes need the same topography file and the compute binary; nothing is shared while they
+run. merge checks that the bundles were computed with the use case's parameters and the
+same topography, and adds the airfields in the use case's order whatever the order of the
+bundles, so that the result is the one of a single launch2.py run. Airfields found in no
+bundle are reported and stay pending: merging the missing bundles later adds them.
+"""
+
+import json
+import math
+import os
+import shutil
+import sys
+
+sys.path.append(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+import launch2
+from src.logging import log_output
+from src.mosaic import compute_pending
+from src.pipeline import Stage, run_pipeline
+from src.shortcuts import normJoin
+from src.use_case_settings import Use_case
+
+BUNDLE_FORMAT = 1
+DONE = ("computed", "restored", "skipped")
+
+
+def run(use_case_file, bundle_folder, shard=None, only=None, output_queue=None):
+    """False when the binary exited with an error (an airfield failed or none could start) or a warp failed"""
+    use_case = Use_case(use_case_file=use_case_file)
+    airfields = launch2.load_airfields(use_case)
+    os.makedirs(bundle_folder, exist_ok=True)
+    options = []
+    if shard:
+        options += ["--shard", shard]
+    if only:
+        options += ["--only", only]
+    failure = []
+
+    def source():
+        # every node is given the whole list, the binary picks its shard from it
+        try:
+            yield from launch2.stream_all_individuals(airfields, use_case, output_queue, folder=bundle_folder,
+                                                      options=options)
+        except RuntimeError as e:
+            failure.append(e)
+
+    warped = run_pipeline(source(), [
+        Stage("warp", lambda airfield: launch2.warp_airfield(airfield, use_case, output_queue, folder=bundle_folder),
+              use_case.pipeline["warp"]),
+    ], queue_size=use_case.pipeline["queue_size"],
+       on_error=lambda stage, airfield, e: failure.append(RuntimeError(f"Error during {stage} for {airfield.name}: {e}")))
+    log_output(f"{len(warped)} airfields in {bundle_folder}", output_queue)
+    # the bundle is kept: its finished airfields merge, the failed ones stay pending
+    for e in failure:
+        log_output(str(e), output_queue)
+    return not failure
+
+
+def read_bundle(folder):
+    path = normJoin(folder, "bundle.json")
+    with open(path, "r", encoding="utf-8") as f:
+        bundle = json.load(f)
+    if bundle.get("format") != BUNDLE_FORMAT:
+        raise ValueError(f"{path}: unknown bundle format {bundle.get('format')}")
+    bundle["folder"] = folder
+    return bundle
+
+
+def check_bundles(bundles, use_case):
+    """Raises unless every bundle was computed like the first one and with the use case's parameters"""
+    first = bundles[0]
+    for bundle in bundles[1:]:
+        for field in ("parameters", "topography"):
+            if bundle[field] != first[field]:
+                raise ValueError(f"{bundle['folder']} and {first['folder']} differ in {field}: "
+                                 f"{bundle[field]} != {first[field]}")
+    parameters = first["parameters"]
+    expected = {"finesse": use_case.glide_ratio, "distSol": use_case.ground_clearance,
+                "securite": use_case.circuit_height, "nodataltitude": use_case.max_altitude,
+                "contours": f"{{name}}_{use_case.calculation_name_short}_noAirfields.geojson",
+                "exportPasses": bool(use_case.exportPasses), "contour_height": use_case.contour_height}
+    for field, value in expected.items():
+        # the binary holds the contour height as a float and prints it back with all its digits
+        same = (math.isclose(parameters[field], value, rel_tol=1e-6) if field == "contour_height"
+                else parameters[field] == value)
+        if not same:
+            raise ValueError(f"bundles have {field} {parameters[field]}, the use case {value}")
+    if first["topography"]["name"] != os.path.basename(use_case.topography_file_path):
+        raise ValueError(f"bundles were computed on {first['topography']['name']}, the use case uses "
+                         f"{os.path.basename(use_case.topography_file_path)}")
+
+
+def merge(use_case_file, bundle_folders, output_queue=None):
+    use_case = Use_case(use_case_file=use_case_file)
+    airfields = launch2.load_airfields(use_case)
+    # sorted, so that an airfield found in several bundles comes from the same one whatever the order given
+    bundles = [read_bundle(folder) for folder in sorted(set(os.path.abspath(folder) for folder in bundle_folders))]
+    if not bundles:
+        raise ValueError("no bundle to merge")
+    check_bundles(bundles, use_case)
+
+    available = {}
+    for bundle in bundles:
+        for entry in bundle["airfields"]:
+            if entry["status"] in DONE:
+                available.setdefault((entry["name"], entry["x"], entry["y"]), bundle["folder"])
+
+    mosaic, pending, removed = compute_pending(use_case, airfields, output_queue)
+    imported, missing = [], []
+    for airfield in pending:
+        folder = available.get((airfield.name, airfield.x, airfield.y))
+        if folder is None:
+            missing.append(airfield.name)
+            continue
+        shutil.copytree(normJoin(folder, airfield.name), normJoin(use_case.calculation_folder_path, airfield.name),
+                        dirs_exist_ok=True)
+        imported.append(airfield)
+    log_output(f"{len(imported)} airfields imported from {len(bundles)} bundles", output_queue)
+    if missing:
+        log_output(f"{len(missing)} airfields in no bundle, left out: {', '.join(missing)}", output_queue)
+
+    # warping is skipped for the airfields already warped on their node
+    launch2.process_airfields(imported, use_case, output_queue)
+    launch2.finish(use_case, mosaic, airfields, imported, removed, output_queue)
+    return missing
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(description="Compute a use case in shards and merge the shard bundles.")
+    commands = parser.add_subparsers(dest="command", required=True)
+    run_parser = commands.add_parser("run", help="compute one shard into a bundle folder")
+    run_parser.add_argument("use_case", help="use case .yaml file")
+    run_parser.add_argument("bundle", help="bundle folder to write")
+    run_parser.add_argument("--shard", help="k/n: airfields k, k+n, k+2n... of the use case (1-based)")
+    run_parser.add_argument("--only", help="file of airfield names, one per line")
+    merge_parser = commands.add_parser("merge", help="merge bundles into the use case's calculation folder")
+    merge_parser.add_argument("use_case", help="use case .yaml file")
+    merge_parser.add_argument("bundles", nargs="+", help="bundle folders, in any order")
+    args = parser.parse_args()
+
+    if args.command == "run":
+        if not args.shard and not args.only:
+            parser.error("run needs --shard or --only")
+        sys.exit(0 if run(args.use_case, args.bundle, args.shard, args.only) else 1)
+    else:
+        missing = merge(args.use_case, args.bundles)
+        sys.exit(1 if missing else 0)
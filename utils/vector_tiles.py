@@ -0,0 +1,399 @@
+import gzip
+import json
+import math
+import multiprocessing
+import os
+import sqlite3
+import struct
+import sys
+
+import numpy as np
+import shapely
+from shapely.geometry import shape, box, Point, LineString, Polygon, MultiPoint, MultiLineString, MultiPolygon, GeometryCollection
+from shapely.geometry.polygon import orient
+from shapely.strtree import STRtree
+
+sys.path.append(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+from src.logging import log_output
+
+
+EXTENT = 4096                    # tile coordinate space, as in the Mapbox Vector Tile spec
+BUFFER = 64                      # clipping margin around each tile, in tile units
+SIMPLIFY_PIXELS = 0.5            # simplification tolerance, in tile units, at each zoom
+EARTH_HALF_CIRCUMFERENCE = 20037508.342789244
+
+
+# ------------------------------------------------------------------ geometry helpers
+
+def lonlat_to_mercator(coords):
+    """(N, 2) array of lon/lat -> (N, 2) array of EPSG:3857 metres."""
+    lon = coords[:, 0]
+    lat = np.clip(coords[:, 1], -85.05112878, 85.05112878)
+    x = lon * EARTH_HALF_CIRCUMFERENCE / 180.0
+    y = np.log(np.tan((90.0 + lat) * np.pi / 360.0)) * EARTH_HALF_CIRCUMFERENCE / np.pi
+    return np.column_stack((x, y))
+
+
+def mercator_to_lonlat(x, y):
+    lon = x * 180.0 / EARTH_HALF_CIRCUMFERENCE
+    lat = math.degrees(2 * math.atan(math.exp(y * math.pi / EARTH_HALF_CIRCUMFERENCE)) - math.pi / 2)
+    return lon, lat
+
+
+def tile_bounds(z, x, y):
+    """Web Mercator bounds (minx, miny, maxx, maxy) of XYZ tile z/x/y."""
+    size = 2 * EARTH_HALF_CIRCUMFERENCE / (2 ** z)
+    minx = -EARTH_HALF_CIRCUMFERENCE + x * size
+    maxy = EARTH_HALF_CIRCUMFERENCE - y * size
+    return minx, maxy - size, minx + size, maxy
+
+
+def tile_range(bounds, z):
+    """XYZ tile index range covering Web Mercator bounds at zoom z."""
+    minx, miny, maxx, maxy = bounds
+    n = 2 ** z
+    size = 2 * EARTH_HALF_CIRCUMFERENCE / n
+    x0 = max(0, int((minx + EARTH_HALF_CIRCUMFERENCE) // size))
+    x1 = min(n - 1, int((maxx + EARTH_HALF_CIRCUMFERENCE) // size))
+    y0 = max(0, int((EARTH_HALF_CIRCUMFERENCE - maxy) // size))
+    y1 = min(n - 1, int((EARTH_HALF_CIRCUMFERENCE - miny) // size))
+    return x0, x1, y0, y1
+
+
+# ------------------------------------------------------------------ protobuf encoding
+
+def _varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def _key(field, wire_type):
+    return _varint((field << 3) | wire_type)
+
+
+def _bytes_field(field, payload):
+    return _key(field, 2) + _varint(len(payload)) + payload
+
+
+def _varint_field(field, value):
+    return _key(field, 0) + _varint(value)
+
+
+def _packed_field(field, values):
+    return _bytes_field(field, b"".join(_varint(v) for v in values))
+
+
+def _zigzag(n):
+    return (n << 1) ^ (n >> 31)
+
+
+def _encode_value(value):
+    """Encodes a property value as a vector tile Value message."""
+    if isinstance(value, bool):
+        return _varint_field(7, int(value))
+    if isinstance(value, int) and value >= 0:
+        return _varint_field(5, value)
+    if isinstance(value, int):
+        return _varint_field(6, (value << 1) ^ (value >> 63))
+    if isinstance(value, float):
+        return _key(3, 1) + struct.pack("<d", value)
+    return _bytes_field(1, str(value).encode("utf-8"))
+
+
+class _GeometryEncoder:
+    """Builds the command/parameter integer stream of one feature's geometry."""
+
+    def __init__(self):
+        self.commands = []
+        self.cx = 0
+        self.cy = 0
+
+    def _move_to(self, points):
+        self.commands.append((1 & 7) | (len(points) << 3))
+        self._params(points)
+
+    def _line_to(self, points):
+        self.commands.append((2 & 7) | (len(points) << 3))
+        self._params(points)
+
+    def _params(self, points):
+        for x, y in points:
+            self.commands.append(_zigzag(x - self.cx))
+            self.commands.append(_zigzag(y - self.cy))
+            self.cx, self.cy = x, y
+
+    def points(self, pts):
+        self._move_to(pts)
+
+    def line(self, pts):
+        if len(pts) < 2:
+            return False
+        self._move_to(pts[:1])
+        self._line_to(pts[1:])
+        return True
+
+    def ring(self, pts):
+        # rings are written without their closing point, ClosePath does that
+        if len(pts) > 1 and pts[0] == pts[-1]:
+            pts = pts[:-1]
+        if len(pts) < 3:
+            return False
+        self._move_to(pts[:1])
+        self._line_to(pts[1:])
+        self.commands.append((7 & 7) | (1 << 3))
+        return True
+
+
+def _to_tile_coords(coords, bounds):
+    """Mercator coordinates -> integer tile coordinates (y down), consecutive duplicates dropped."""
+    minx, miny, maxx, maxy = bounds
+    sx = EXTENT / (maxx - minx)
+    sy = EXTENT / (maxy - miny)
+    out = []
+    for x, y in coords:
+        p = (int(round((x - minx) * sx)), int(round((maxy - y) * sy)))
+        if not out or out[-1] != p:
+            out.append(p)
+    return out
+
+
+def _encode_geometry(geom, bounds):
+    """Returns (type, command list) or None if the geometry vanishes at this zoom."""
+    encoder = _GeometryEncoder()
+    if isinstance(geom, (Point, MultiPoint)):
+        pts = [geom] if isinstance(geom, Point) else list(geom.geoms)
+        coords = [_to_tile_coords([(p.x, p.y)], bounds)[0] for p in pts]
+        encoder.points(coords)
+        return 1, encoder.commands
+    if isinstance(geom, (LineString, MultiLineString)):
+        lines = [geom] if isinstance(geom, LineString) else list(geom.geoms)
+        written = False
+        for line in lines:
+            written |= encoder.line(_to_tile_coords(line.coords, bounds))
+        return (2, encoder.commands) if written else None
+    if isinstance(geom, (Polygon, MultiPolygon)):
+        polygons = [geom] if isinstance(geom, Polygon) else list(geom.geoms)
+        written = False
+        for polygon in polygons:
+            # counter-clockwise exterior in y-up mercator = clockwise in y-down tile space
+            polygon = orient(polygon, sign=1.0)
+            if not encoder.ring(_to_tile_coords(polygon.exterior.coords, bounds)):
+                continue
+            written = True
+            for interior in polygon.interiors:
+                encoder.ring(_to_tile_coords(interior.coords, bounds))
+        return (3, encoder.commands) if written else None
+    if isinstance(geom, GeometryCollection):
+        # clipping can produce mixed collections, keep the highest dimension
+        for single, multi in ((Polygon, MultiPolygon), (LineString, MultiLineString), (Point, MultiPoint)):
+            parts = []
+            for g in geom.geoms:
+                if isinstance(g, single):
+                    parts.append(g)
+                elif isinstance(g, multi):
+                    parts.extend(g.geoms)
+            parts = [g for g in parts if not g.is_empty]
+            if parts:
+                return _encode_geometry(multi(parts), bounds)
+    return None
+
+
+def encode_layer(name, features, bounds):
+    """features: list of (geometry in mercator, properties dict)."""
+    keys, values = [], []
+    key_index, value_index = {}, {}
+    encoded_features = []
+    for geom, properties in features:
+        encoded = _encode_geometry(geom, bounds)
+        if encoded is None:
+            continue
+        geom_type, commands = encoded
+        tags = []
+        for k, v in properties.items():
+            if v is None:
+                continue
+            if k not in key_index:
+                key_index[k] = len(keys)
+                keys.append(k)
+            value_key = (type(v).__name__, v)
+            if value_key not in value_index:
+                value_index[value_key] = len(values)
+                values.append(v)
+            tags += [key_index[k], value_index[value_key]]
+        feature = _packed_field(2, tags) + _varint_field(3, geom_type) + _packed_field(4, commands)
+        encoded_features.append(_bytes_field(2, feature))
+
+    if not encoded_features:
+        return b""
+    layer = _varint_field(15, 2) + _bytes_field(1, name.encode("utf-8"))
+    layer += b"".join(encoded_features)
+    layer += b"".join(_bytes_field(3, k.encode("utf-8")) for k in keys)
+    layer += b"".join(_bytes_field(4, _encode_value(v)) for v in values)
+    layer += _varint_field(5, EXTENT)
+    return _bytes_field(3, layer)
+
+
+# ------------------------------------------------------------------ tiling
+
+_zoom_layers = None   # per worker: {layer name: (geometries, properties, STRtree)}
+
+
+def _init_worker(layers):
+    global _zoom_layers
+    _zoom_layers = {}
+    for name, (geometries, properties) in layers.items():
+        _zoom_layers[name] = (geometries, properties, STRtree(geometries))
+
+
+def _make_tile(job):
+    z, x, y = job
+    bounds = tile_bounds(z, x, y)
+    margin = (bounds[2] - bounds[0]) * BUFFER / EXTENT
+    clip = (bounds[0] - margin, bounds[1] - margin, bounds[2] + margin, bounds[3] + margin)
+    clip_box = box(*clip)
+
+    data = b""
+    for name, (geometries, properties, tree) in _zoom_layers.items():
+        features = []
+        for index in tree.query(clip_box):
+            geom = geometries[index]
+            if not geom.intersects(clip_box):
+                continue
+            clipped = geom if clip_box.contains(geom) else geom.intersection(clip_box)
+            if not clipped.is_empty:
+                features.append((clipped, properties[index]))
+        data += encode_layer(name, features, bounds)
+
+    if not data:
+        return None
+    # MBTiles stores rows in TMS order (y flipped)
+    return z, x, (2 ** z - 1) - y, gzip.compress(data)
+
+
+def load_layer(geojson_path):
+    """Reads a GeoJSON file in EPSG:4326 into mercator geometries and property dicts."""
+    with open(geojson_path, "r") as f:
+        data = json.load(f)
+    geometries, properties = [], []
+    for feature in data.get("features", []):
+        if not feature.get("geometry"):
+            continue
+        geom = shapely.transform(shape(feature["geometry"]), lonlat_to_mercator)
+        if geom.is_empty:
+            continue
+        geometries.append(geom)
+        properties.append(feature.get("properties") or {})
+    return geometries, properties
+
+
+def create_vector_mbtiles(filename, name, layers, bounds4326, minzoom, maxzoom):
+    if os.path.exists(filename):
+        os.remove(filename)
+    conn = sqlite3.connect(filename)
+    cursor = conn.cursor()
+    cursor.execute("CREATE TABLE metadata (name TEXT, value TEXT)")
+    cursor.execute("""
+        CREATE TABLE tiles (
+            zoom_level INTEGER,
+            tile_column INTEGER,
+            tile_row INTEGER,
+            tile_data BLOB,
+            PRIMARY KEY (zoom_level, tile_column, tile_row)
+        )
+    """)
+    vector_layers = [{"id": layer, "fields": {}, "minzoom": minzoom, "maxzoom": maxzoom} for layer in layers]
+    metadata = [
+        ("name", name),
+        ("type", "overlay"),
+        ("version", "1"),
+        ("format", "pbf"),
+        ("minzoom", str(minzoom)),
+        ("maxzoom", str(maxzoom)),
+        ("bounds", ",".join(f"{v:.6f}" for v in bounds4326)),
+        ("json", json.dumps({"vector_layers": vector_layers})),
+    ]
+    cursor.executemany("INSERT INTO metadata VALUES (?, ?)", metadata)
+    conn.commit()
+    return conn
+
+
+def main(output_path, layer_files, minzoom=6, maxzoom=12, name=None, processes=None, output_queue=None):
+    """
+    Cuts GeoJSON layers (EPSG:4326) into Mapbox Vector Tiles and stores them in an MBTiles file.
+
+    Args:
+        output_path (str): .mbtiles file to create (overwritten).
+        layer_files (dict): {layer name: geojson path}, e.g. contours, sectors, passes.
+        minzoom, maxzoom (int): zoom range to generate.
+        name (str): MBTiles name metadata, defaults to the file name.
+        processes (int): worker count, defaults to all cores.
+    """
+    layers = {}
+    for layer_name, path in layer_files.items():
+        if path and os.path.exists(path):
+            layers[layer_name] = load_layer(path)
+        else:
+            log_output(f"vector tiles: {path} not found, skipping layer {layer_name}", output_queue)
+    if not any(geoms for geoms, _ in layers.values()):
+        log_output("vector tiles: nothing to tile", output_queue)
+        return
+
+    all_bounds = [g.bounds for geoms, _ in layers.values() for g in geoms]
+    bounds = (min(b[0] for b in all_bounds), min(b[1] for b in all_bounds),
+              max(b[2] for b in all_bounds), max(b[3] for b in all_bounds))
+    lon0, lat0 = mercator_to_lonlat(bounds[0], bounds[1])
+    lon1, lat1 = mercator_to_lonlat(bounds[2], bounds[3])
+
+    name = name or os.path.splitext(os.path.basename(output_path))[0]
+    conn = create_vector_mbtiles(output_path, name, list(layers), (lon0, lat0, lon1, lat1), minzoom, maxzoom)
+    cursor = conn.cursor()
+
+    for z in range(minzoom, maxzoom + 1):
+        # simplify once per zoom, to a fraction of this zoom's tile pixel
+        tolerance = SIMPLIFY_PIXELS * 2 * EARTH_HALF_CIRCUMFERENCE / (2 ** z) / EXTENT
+        zoom_layers = {}
+        for layer_name, (geometries, properties) in layers.items():
+            simplified, props = [], []
+            for geom, prop in zip(geometries, properties):
+                g = geom if isinstance(geom, (Point, MultiPoint)) else geom.simplify(tolerance, preserve_topology=True)
+                if not g.is_empty:
+                    simplified.append(g)
+                    props.append(prop)
+            zoom_layers[layer_name] = (simplified, props)
+
+        x0, x1, y0, y1 = tile_range(bounds, z)
+        jobs = [(z, x, y) for x in range(x0, x1 + 1) for y in range(y0, y1 + 1)]
+        log_output(f"vector tiles: zoom {z}, {len(jobs)} tiles", output_queue)
+
+        with multiprocessing.Pool(processes=processes, initializer=_init_worker, initargs=(zoom_layers,)) as pool:
+            for tile in pool.imap_unordered(_make_tile, jobs, chunksize=16):
+                if tile is not None:
+                    cursor.execute("INSERT OR REPLACE INTO tiles VALUES (?, ?, ?, ?)", tile)
+        conn.commit()
+
+    conn.close()
+    log_output(f"vector tiles written to {output_path}", output_queue)
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(description="Cut contours, sectors and passes GeoJSON into an MBTiles of vector tiles.")
+    parser.add_argument("output", help="output .mbtiles file")
+    parser.add_argument("--contours", help="contours GeoJSON (EPSG:4326)")
+    parser.add_argument("--sectors", help="sectors GeoJSON (EPSG:4326)")
+    parser.add_argument("--passes", help="passes GeoJSON (EPSG:4326)")
+    parser.add_argument("--minzoom", type=int, default=6)
+    parser.add_argument("--maxzoom", type=int, default=12)
+    parser.add_argument("--processes", type=int, default=None)
+    args = parser.parse_args()
+
+    main(args.output, {"contours": args.contours, "sectors": args.sectors, "passes": args.passes},
+         args.minzoom, args.maxzoom, processes=args.processes)